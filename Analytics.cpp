@@ -0,0 +1,225 @@
+#include "Analytics.h"
+#include "SlotMap.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string_view>
+#include <unordered_map>
+
+using namespace std;
+
+const double AVERAGE_PERCENTILES[5] = {0.10, 0.25, 0.50, 0.75, 0.90};
+
+const uint64_t LANE_ONES = 0x0101010101010101ULL;
+const uint64_t LANE_LOW7 = 0x7F7F7F7F7F7F7F7FULL;
+const uint64_t LANE_PAIRS = 0x00FF00FF00FF00FFULL;
+const size_t LANE_FLUSH_WORDS = 255;
+
+uint64_t GradeHistogram::total() const
+{
+    uint64_t sum = 0;
+    for (int g = GRADE_MIN; g <= GRADE_MAX; g++)
+        sum += counts[g];
+    return sum;
+}
+
+double GradeHistogram::mean() const
+{
+    uint64_t n = total();
+    if (n == 0)
+        return 0.0;
+    uint64_t sum = 0;
+    for (int g = GRADE_MIN; g <= GRADE_MAX; g++)
+        sum += counts[g] * g;
+    return (double)sum / n;
+}
+
+void GradeHistogram::add(const GradeHistogram &other)
+{
+    for (int g = GRADE_MIN; g <= GRADE_MAX; g++)
+        counts[g] += other.counts[g];
+}
+
+static uint64_t laneSum(uint64_t lanes)
+{
+    uint64_t pairs = (lanes & LANE_PAIRS) + ((lanes >> 8) & LANE_PAIRS);
+    return (pairs * 0x0001000100010001ULL) >> 48;
+}
+
+void countGrades(const uint8_t *grades, size_t n, uint64_t counts[GRADE_MAX + 1])
+{
+    uint64_t lanes[GRADE_MAX + 1] = {};
+    size_t words = n / sizeof(uint64_t);
+    for (size_t w = 0; w < words; w++)
+    {
+        uint64_t word;
+        memcpy(&word, grades + w * sizeof(uint64_t), sizeof(word));
+        for (int g = GRADE_MIN; g <= GRADE_MAX; g++)
+        {
+            uint64_t diff = word ^ (LANE_ONES * g);
+            uint64_t zero = ~(((diff & LANE_LOW7) + LANE_LOW7) | diff | LANE_LOW7);
+            lanes[g] += zero >> 7;
+        }
+        if ((w + 1) % LANE_FLUSH_WORDS == 0)
+        {
+            for (int g = GRADE_MIN; g <= GRADE_MAX; g++)
+            {
+                counts[g] += laneSum(lanes[g]);
+                lanes[g] = 0;
+            }
+        }
+    }
+    for (int g = GRADE_MIN; g <= GRADE_MAX; g++)
+        counts[g] += laneSum(lanes[g]);
+    for (size_t i = words * sizeof(uint64_t); i < n; i++)
+    {
+        if (grades[i] >= GRADE_MIN && grades[i] <= GRADE_MAX)
+            counts[grades[i]]++;
+    }
+}
+
+struct ChunkTally
+{
+    unordered_map<string_view, size_t> subjectIndex;
+    vector<string_view> subjectNames;
+    vector<map<int, vector<uint8_t>>> packed;
+};
+
+static int groupKey(const Student &student, AnalyticsGrouping grouping, int cohortWidth)
+{
+    if (grouping == GROUP_BY_COURSE)
+        return student.course;
+    return student.year - student.year % cohortWidth;
+}
+
+struct AnalyticsPiece
+{
+    const Student *records;
+    size_t size;
+    size_t base;
+};
+
+static void tallyChunk(const AnalyticsPiece &piece, AnalyticsGrouping grouping, int cohortWidth, ChunkTally &tally,
+                       vector<float> &averages, vector<int> &keys)
+{
+    for (size_t k = 0; k < piece.size; k++)
+    {
+        const Student &student = piece.records[k];
+        size_t i = piece.base + k;
+        if (student.id == INVALID_STUDENT_ID)
+            continue;
+        int key = groupKey(student, grouping, cohortWidth);
+        keys[i] = key;
+        int sum = 0;
+        int n = 0;
+        for (int j = 0; j < student.subjects.size(); j++)
+        {
+            string_view subject = student.subjects.subject(j);
+            auto found = tally.subjectIndex.emplace(subject, tally.subjectNames.size());
+            if (found.second)
+            {
+                tally.subjectNames.push_back(subject);
+                tally.packed.emplace_back();
+            }
+            vector<uint8_t> &grades = tally.packed[found.first->second][key];
+            GradeSpan span = student.subjects.grades(j);
+            grades.insert(grades.end(), span.data, span.data + span.size);
+            for (size_t g = 0; g < span.size; g++)
+                sum += span.data[g];
+            n += span.size;
+        }
+        averages[i] = n > 0 ? (float)sum / n : -1.0f;
+    }
+}
+
+static AverageSummary summarize(vector<float> &values)
+{
+    AverageSummary summary;
+    summary.count = values.size();
+    if (values.empty())
+        return summary;
+    double total = 0;
+    for (float v : values)
+        total += v;
+    summary.mean = total / values.size();
+    double squares = 0;
+    for (float v : values)
+        squares += (v - summary.mean) * (v - summary.mean);
+    summary.variance = squares / values.size();
+    sort(values.begin(), values.end());
+    for (int p = 0; p < 5; p++)
+    {
+        size_t rank = (size_t)ceil(AVERAGE_PERCENTILES[p] * values.size());
+        summary.percentiles[p] = values[max<size_t>(rank, 1) - 1];
+    }
+    return summary;
+}
+
+// The roster may come in several spans (a pinned version is stored in
+// chunks); each span is cut into pieces of at most PARALLEL_FOR_GRAIN records.
+RosterAnalytics analyzeRoster(const vector<StudentSpan> &spans, AnalyticsGrouping grouping, int cohortWidth)
+{
+    vector<AnalyticsPiece> pieces;
+    size_t count = 0;
+    for (const StudentSpan &span : spans)
+    {
+        for (size_t from = 0; from < span.size; from += PARALLEL_FOR_GRAIN)
+            pieces.push_back({span.records + from, min(PARALLEL_FOR_GRAIN, span.size - from), count + from});
+        count += span.size;
+    }
+    size_t chunks = max<size_t>(1, pieces.size());
+    pieces.resize(chunks, {nullptr, 0, count});
+    vector<ChunkTally> tallies(chunks);
+    vector<float> averages(count, -1.0f);
+    vector<int> keys(count, 0);
+    vector<map<string_view, map<int, GradeHistogram>>> counted(chunks);
+    parallelFor(0, chunks, 1, [&](size_t first, size_t last) {
+        for (size_t c = first; c < last; c++)
+        {
+            tallyChunk(pieces[c], grouping, cohortWidth, tallies[c], averages, keys);
+            for (size_t s = 0; s < tallies[c].subjectNames.size(); s++)
+            {
+                auto &groups = counted[c][tallies[c].subjectNames[s]];
+                for (const auto &entry : tallies[c].packed[s])
+                    countGrades(entry.second.data(), entry.second.size(), groups[entry.first].counts);
+            }
+        }
+    });
+
+    map<string_view, SubjectAnalytics> subjects;
+    for (const auto &chunk : counted)
+    {
+        for (const auto &subject : chunk)
+        {
+            SubjectAnalytics &result = subjects[subject.first];
+            for (const auto &group : subject.second)
+            {
+                result.groups[group.first].add(group.second);
+                result.overall.add(group.second);
+            }
+        }
+    }
+
+    RosterAnalytics analytics;
+    for (auto &entry : subjects)
+    {
+        entry.second.subject = string(entry.first);
+        analytics.subjects.push_back(move(entry.second));
+    }
+
+    vector<float> all;
+    map<int, vector<float>> grouped;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (averages[i] < 0)
+            continue;
+        all.push_back(averages[i]);
+        grouped[keys[i]].push_back(averages[i]);
+    }
+    analytics.averages = summarize(all);
+    for (auto &entry : grouped)
+        analytics.groupAverages[entry.first] = summarize(entry.second);
+    return analytics;
+}
@@ -0,0 +1,56 @@
+#ifndef UTP_ANALYTICS_H
+#define UTP_ANALYTICS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include "Student.h"
+
+const int GRADE_MIN = 1;
+const int GRADE_MAX = 5;
+
+enum AnalyticsGrouping
+{
+    GROUP_BY_COURSE,
+    GROUP_BY_COHORT
+};
+
+struct GradeHistogram
+{
+    std::uint64_t counts[GRADE_MAX + 1] = {};
+
+    std::uint64_t total() const;
+    double mean() const;
+    void add(const GradeHistogram &other);
+};
+
+struct SubjectAnalytics
+{
+    std::string subject;
+    GradeHistogram overall;
+    std::map<int, GradeHistogram> groups;
+};
+
+struct AverageSummary
+{
+    std::size_t count = 0;
+    double mean = 0;
+    double variance = 0;
+    double percentiles[5] = {};
+};
+
+extern const double AVERAGE_PERCENTILES[5];
+
+struct RosterAnalytics
+{
+    std::vector<SubjectAnalytics> subjects;
+    AverageSummary averages;
+    std::map<int, AverageSummary> groupAverages;
+};
+
+void countGrades(const std::uint8_t *grades, std::size_t n, std::uint64_t counts[GRADE_MAX + 1]);
+RosterAnalytics analyzeRoster(const std::vector<StudentSpan> &spans, AnalyticsGrouping grouping, int cohortWidth);
+
+#endif
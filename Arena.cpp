@@ -0,0 +1,94 @@
+#include "Arena.h"
+#include "VersionStore.h"
+
+#include <cstring>
+#include <memory>
+
+using namespace std;
+
+static vector<vector<char>> loadBuffers;
+static vector<pair<shared_ptr<const char>, size_t>> mappedRegions;
+static vector<unique_ptr<char[]>> editChunks;
+static size_t editUsed = ARENA_CHUNK_SIZE;
+static size_t editBytes = 0;
+
+const char *arenaCopy(string_view s)
+{
+    if (s.empty())
+        return "";
+
+    char *out;
+    if (s.size() > ARENA_CHUNK_SIZE / 4)
+    {
+        editChunks.emplace_back(new char[s.size()]);
+        out = editChunks.back().get();
+        editBytes += s.size();
+        if (editChunks.size() > 1)
+            swap(editChunks.back(), editChunks[editChunks.size() - 2]);
+    }
+    else
+    {
+        if (editUsed + s.size() > ARENA_CHUNK_SIZE)
+        {
+            editChunks.emplace_back(new char[ARENA_CHUNK_SIZE]);
+            editUsed = 0;
+            editBytes += ARENA_CHUNK_SIZE;
+        }
+        out = editChunks.back().get() + editUsed;
+        editUsed += s.size();
+    }
+    memcpy(out, s.data(), s.size());
+    return out;
+}
+
+const char *adoptLoadBuffer(vector<char> &&buffer)
+{
+    loadBuffers.push_back(move(buffer));
+    return loadBuffers.back().data();
+}
+
+const char *adoptMappedRegion(shared_ptr<const char> region, size_t size)
+{
+    mappedRegions.emplace_back(move(region), size);
+    return mappedRegions.back().first.get();
+}
+
+struct ArenaGeneration
+{
+    vector<vector<char>> loadBuffers;
+    vector<pair<shared_ptr<const char>, size_t>> mappedRegions;
+    vector<unique_ptr<char[]>> editChunks;
+};
+
+// Pinned roster versions may still point into the current arenas, so they
+// are handed to the version store to be freed once no reader can see them.
+void resetStringArenas()
+{
+    size_t bytes = stringArenaBytes();
+    auto generation = make_shared<ArenaGeneration>();
+    generation->loadBuffers = move(loadBuffers);
+    generation->mappedRegions = move(mappedRegions);
+    generation->editChunks = move(editChunks);
+    loadBuffers.clear();
+    mappedRegions.clear();
+    editChunks.clear();
+    retireRosterMemory(move(generation), bytes);
+    editUsed = ARENA_CHUNK_SIZE;
+    editBytes = 0;
+}
+
+size_t stringArenaBytes()
+{
+    size_t bytes = editBytes;
+    for (const vector<char> &buffer : loadBuffers)
+        bytes += buffer.size();
+    return bytes;
+}
+
+size_t mappedArenaBytes()
+{
+    size_t bytes = 0;
+    for (const auto &region : mappedRegions)
+        bytes += region.second;
+    return bytes;
+}
@@ -0,0 +1,18 @@
+#ifndef UTP_ARENA_H
+#define UTP_ARENA_H
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+const size_t ARENA_CHUNK_SIZE = 64 * 1024;
+
+const char *arenaCopy(std::string_view s);
+const char *adoptLoadBuffer(std::vector<char> &&buffer);
+const char *adoptMappedRegion(std::shared_ptr<const char> region, size_t size);
+void resetStringArenas();
+size_t stringArenaBytes();
+size_t mappedArenaBytes();
+
+#endif
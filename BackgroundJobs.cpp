@@ -0,0 +1,71 @@
+#include "BackgroundJobs.h"
+
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+struct BackgroundJob
+{
+    string title;
+    thread worker;
+    atomic<bool> done{false};
+    function<void()> completion;
+};
+
+static vector<unique_ptr<BackgroundJob>> jobs;
+
+static void runJob(BackgroundJob *job, function<function<void()>()> work)
+{
+    job->completion = work();
+    work = nullptr;
+    job->done.store(true);
+}
+
+void startBackgroundJob(const string &title, function<function<void()>()> work)
+{
+    if (runningBackgroundJobs() >= BACKGROUND_JOB_LIMIT)
+    {
+        function<void()> completion = work();
+        work = nullptr;
+        completion();
+        return;
+    }
+    jobs.emplace_back(new BackgroundJob());
+    BackgroundJob *job = jobs.back().get();
+    job->title = title;
+    job->worker = thread(runJob, job, move(work));
+    cout << "Задача «" << title << "» выполняется в фоне; результат появится перед следующим меню.\n";
+}
+
+void finishBackgroundJobs(bool wait)
+{
+    for (size_t i = 0; i < jobs.size();)
+    {
+        BackgroundJob &job = *jobs[i];
+        if (!wait && !job.done.load())
+        {
+            i++;
+            continue;
+        }
+        job.worker.join();
+        cout << "\n--- Фоновая задача «" << job.title << "» завершена ---\n";
+        if (job.completion)
+            job.completion();
+        jobs.erase(jobs.begin() + i);
+    }
+}
+
+int runningBackgroundJobs()
+{
+    int running = 0;
+    for (const auto &job : jobs)
+    {
+        if (!job->done.load())
+            running++;
+    }
+    return running;
+}
@@ -0,0 +1,18 @@
+#ifndef UTP_BACKGROUNDJOBS_H
+#define UTP_BACKGROUNDJOBS_H
+
+#include <functional>
+#include <string>
+
+const int BACKGROUND_JOB_LIMIT = 8;
+const int BACKGROUND_JOB_MIN_RECORDS = 1 << 15;
+
+// Runs work on a thread of its own. Whatever the work captures is destroyed
+// on that thread when it ends; the function it returns runs later on the
+// interactive thread, from finishBackgroundJobs(), to report the result.
+// Past BACKGROUND_JOB_LIMIT running jobs both run at once, here.
+void startBackgroundJob(const std::string &title, std::function<std::function<void()>()> work);
+void finishBackgroundJobs(bool wait);
+int runningBackgroundJobs();
+
+#endif
@@ -0,0 +1,733 @@
+#include "BinaryStore.h"
+#include "Memory.h"
+#include "SlotMap.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace std;
+
+const char BINARY_STORE_MAGIC[8] = {'U', 'T', 'P', 'B', 'I', 'N', '3', '\0'};
+const char BINARY_STORE_V2_MAGIC[8] = {'U', 'T', 'P', 'B', 'I', 'N', '2', '\0'};
+const int BINARY_STORE_V2_FIELDS = 9;
+const int64_t BINARY_STORE_MIN_HEADROOM = 64;
+
+// Slot layout of version 2 files, which kept three fixed subject/grade pairs per record.
+struct BinaryStoreSlotV2
+{
+    int32_t live;
+    int32_t year;
+    int32_t course;
+    uint32_t lengths[BINARY_STORE_V2_FIELDS];
+    uint64_t offset;
+};
+
+static_assert(sizeof(BinaryStoreHeader) % alignof(BinaryStoreSlot) == 0, "slots must stay aligned in the file");
+
+static bool storeBound = false;
+static string storePath;
+static int64_t storeSize = 0;
+static int64_t storeTime = 0;
+
+static bool tableLoaded = false;
+static int64_t slotCapacity = 0;
+static vector<BinaryStoreSlot> slotTable;
+static vector<int> freeSlots;
+static uint64_t heapEnd = 0;
+static map<uint64_t, uint64_t> freeByOffset;
+static set<pair<uint64_t, uint64_t>> freeBySize;
+static uint64_t freeBytes = 0;
+
+static unordered_map<uint64_t, int> slotOfId;
+static unordered_set<uint64_t> dirtyIds;
+static vector<int> erasedSlots;
+
+static int64_t sourceTimeOf(const string &path)
+{
+    error_code ec;
+    auto t = filesystem::last_write_time(path, ec);
+    if (ec)
+        return 0;
+    return (int64_t)t.time_since_epoch().count();
+}
+
+static void stampStore()
+{
+    error_code ec;
+    storeSize = (int64_t)filesystem::file_size(storePath, ec);
+    storeTime = sourceTimeOf(storePath);
+}
+
+static bool storeUnchanged()
+{
+    error_code ec;
+    int64_t size = (int64_t)filesystem::file_size(storePath, ec);
+    return !ec && size == storeSize && sourceTimeOf(storePath) == storeTime;
+}
+
+template <typename Slot>
+static uint64_t slotOffsetOf(int64_t slot)
+{
+    return sizeof(BinaryStoreHeader) + slot * sizeof(Slot);
+}
+
+template <typename Slot>
+static uint64_t blockLengthOf(const Slot &slot)
+{
+    uint64_t length = 0;
+    for (uint32_t field : slot.lengths)
+        length += field;
+    return length;
+}
+
+uint64_t binarySlotOffset(int64_t slot)
+{
+    return slotOffsetOf<BinaryStoreSlot>(slot);
+}
+
+uint64_t binarySlotBlockLength(const BinaryStoreSlot &slot)
+{
+    return blockLengthOf(slot);
+}
+
+static void studentFields(const Student &student, string_view values[BINARY_STORE_FIELDS])
+{
+    values[0] = student.name;
+    values[1] = student.surname;
+    values[2] = student.middleName;
+    values[3] = student.subjects.encoded();
+}
+
+static BinaryStoreSlot makeSlot(const Student &student)
+{
+    BinaryStoreSlot slot = {};
+    slot.live = 1;
+    slot.year = student.year;
+    slot.course = student.course;
+    string_view values[BINARY_STORE_FIELDS];
+    studentFields(student, values);
+    for (int f = 0; f < BINARY_STORE_FIELDS; f++)
+        slot.lengths[f] = values[f].size();
+    return slot;
+}
+
+static void appendBlock(const Student &student, string &block)
+{
+    string_view values[BINARY_STORE_FIELDS];
+    studentFields(student, values);
+    for (string_view value : values)
+        block.append(value);
+}
+
+static BinaryStoreHeader makeHeader(int64_t capacity, int64_t count, uint32_t generation)
+{
+    BinaryStoreHeader header = {};
+    memcpy(header.magic, BINARY_STORE_MAGIC, sizeof(header.magic));
+    header.slotSize = sizeof(BinaryStoreSlot);
+    header.slotCapacity = capacity;
+    header.slotCount = count;
+    header.generation = generation;
+    return header;
+}
+
+static int headerVersion(const BinaryStoreHeader &header)
+{
+    if (memcmp(header.magic, BINARY_STORE_MAGIC, sizeof(header.magic)) == 0 &&
+        header.slotSize == (int32_t)sizeof(BinaryStoreSlot))
+        return BINARY_STORE_VERSION;
+    if (memcmp(header.magic, BINARY_STORE_V2_MAGIC, sizeof(header.magic)) == 0 &&
+        header.slotSize == (int32_t)sizeof(BinaryStoreSlotV2))
+        return 2;
+    return 0;
+}
+
+template <typename Slot>
+static bool headerValid(const BinaryStoreHeader &header, uint64_t fileSize)
+{
+    return header.slotCount >= 0 && header.slotCount <= header.slotCapacity &&
+           (uint64_t)header.slotCapacity <= fileSize / sizeof(Slot) &&
+           slotOffsetOf<Slot>(header.slotCapacity) <= fileSize;
+}
+
+static bool headerValid(const BinaryStoreHeader &header, uint64_t fileSize)
+{
+    return headerVersion(header) == BINARY_STORE_VERSION && headerValid<BinaryStoreSlot>(header, fileSize);
+}
+
+int binaryStoreVersion(const char *data, size_t size)
+{
+    if (size < sizeof(BinaryStoreHeader))
+        return 0;
+    BinaryStoreHeader header;
+    memcpy(&header, data, sizeof(header));
+    return headerVersion(header);
+}
+
+bool isBinaryStore(const char *data, size_t size)
+{
+    return binaryStoreVersion(data, size) != 0;
+}
+
+bool readBinaryStoreHeader(istream &in, BinaryStoreHeader &header)
+{
+    in.clear();
+    in.seekg(0);
+    in.read((char *)&header, sizeof(header));
+    return (bool)in && memcmp(header.magic, BINARY_STORE_MAGIC, sizeof(header.magic)) == 0 &&
+           header.slotSize == (int32_t)sizeof(BinaryStoreSlot);
+}
+
+uint32_t binaryStoreGeneration(const string &path)
+{
+    ifstream in(path, ios::binary);
+    BinaryStoreHeader header;
+    if (!in.read((char *)&header, sizeof(header)))
+        return 0;
+    return headerVersion(header) != 0 ? header.generation : 0;
+}
+
+bool decodeBinarySlot(const BinaryStoreSlot &slot, const char *block, Student &student)
+{
+    string_view values[BINARY_STORE_FIELDS];
+    for (int f = 0; f < BINARY_STORE_FIELDS; f++)
+    {
+        values[f] = string_view(block, slot.lengths[f]);
+        block += slot.lengths[f];
+    }
+    student.year = slot.year;
+    student.course = slot.course;
+    student.name = values[0];
+    student.surname = values[1];
+    student.middleName = values[2];
+    return SubjectList::view(values[3], student.subjects);
+}
+
+static bool decodeSlot(const BinaryStoreSlot &slot, const char *block, Student &student)
+{
+    return decodeBinarySlot(slot, block, student);
+}
+
+static bool decodeSlot(const BinaryStoreSlotV2 &slot, const char *block, Student &student)
+{
+    string_view values[BINARY_STORE_V2_FIELDS];
+    for (int f = 0; f < BINARY_STORE_V2_FIELDS; f++)
+    {
+        values[f] = string_view(block, slot.lengths[f]);
+        block += slot.lengths[f];
+    }
+    student.year = slot.year;
+    student.course = slot.course;
+    student.name = values[0];
+    student.surname = values[1];
+    student.middleName = values[2];
+    return buildLegacySubjects(values + 3, LEGACY_BINARY_SUBJECTS, student.subjects);
+}
+
+template <typename Slot>
+static bool slotInBounds(const Slot &slot, const BinaryStoreHeader &header, uint64_t size)
+{
+    uint64_t length = blockLengthOf(slot);
+    return length == 0 || (slot.offset >= slotOffsetOf<Slot>(header.slotCapacity) && slot.offset <= size &&
+                           length <= size - slot.offset);
+}
+
+template <typename Slot>
+static int liveCountOf(const char *data, size_t size, const BinaryStoreHeader &header)
+{
+    if (!headerValid<Slot>(header, size))
+        return -1;
+    int live = 0;
+    for (int64_t i = 0; i < header.slotCount; i++)
+    {
+        Slot slot;
+        memcpy(&slot, data + slotOffsetOf<Slot>(i), sizeof(slot));
+        if (!slot.live)
+            continue;
+        if (!slotInBounds(slot, header, size))
+            return -1;
+        live++;
+    }
+    return live;
+}
+
+template <typename Slot>
+static bool decodeSlotsOf(const char *data, size_t size, const BinaryStoreHeader &header, Student *arr, int count,
+                          vector<int> &slots)
+{
+    if (!headerValid<Slot>(header, size))
+        return false;
+    for (int64_t i = 0; i < header.slotCount && (int)slots.size() < count; i++)
+    {
+        Slot slot;
+        memcpy(&slot, data + slotOffsetOf<Slot>(i), sizeof(slot));
+        if (!slot.live)
+            continue;
+        if (!slotInBounds(slot, header, size) || !decodeSlot(slot, data + slot.offset, arr[slots.size()]))
+            return false;
+        slots.push_back(i);
+    }
+    return (int)slots.size() == count;
+}
+
+int binaryStoreLiveCount(const char *data, size_t size)
+{
+    BinaryStoreHeader header;
+    memcpy(&header, data, sizeof(header));
+    int version = headerVersion(header);
+    if (version == BINARY_STORE_VERSION)
+        return liveCountOf<BinaryStoreSlot>(data, size, header);
+    if (version == 2)
+        return liveCountOf<BinaryStoreSlotV2>(data, size, header);
+    return -1;
+}
+
+bool decodeBinaryStore(const char *data, size_t size, Student *arr, int count, vector<int> &slots)
+{
+    BinaryStoreHeader header;
+    memcpy(&header, data, sizeof(header));
+    slots.clear();
+    int version = headerVersion(header);
+    if (version == BINARY_STORE_VERSION)
+        return decodeSlotsOf<BinaryStoreSlot>(data, size, header, arr, count, slots);
+    if (version == 2)
+        return decodeSlotsOf<BinaryStoreSlotV2>(data, size, header, arr, count, slots);
+    return false;
+}
+
+static void addFreeExtent(uint64_t offset, uint64_t length)
+{
+    freeByOffset.emplace(offset, length);
+    freeBySize.emplace(length, offset);
+}
+
+static void removeFreeExtent(map<uint64_t, uint64_t>::iterator it)
+{
+    freeBySize.erase({it->second, it->first});
+    freeByOffset.erase(it);
+}
+
+static void releaseExtent(uint64_t offset, uint64_t length)
+{
+    if (length == 0)
+        return;
+    freeBytes += length;
+    auto next = freeByOffset.lower_bound(offset);
+    if (next != freeByOffset.end() && offset + length == next->first)
+    {
+        length += next->second;
+        auto merged = next++;
+        removeFreeExtent(merged);
+    }
+    if (next != freeByOffset.begin())
+    {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset)
+        {
+            offset = prev->first;
+            length += prev->second;
+            removeFreeExtent(prev);
+        }
+    }
+    addFreeExtent(offset, length);
+}
+
+static uint64_t allocateExtent(uint64_t length)
+{
+    if (length == 0)
+        return 0;
+    auto fit = freeBySize.lower_bound({length, 0});
+    if (fit == freeBySize.end())
+    {
+        uint64_t offset = heapEnd;
+        heapEnd += length;
+        return offset;
+    }
+    uint64_t offset = fit->second;
+    uint64_t rest = fit->first - length;
+    removeFreeExtent(freeByOffset.find(offset));
+    if (rest > 0)
+        addFreeExtent(offset + length, rest);
+    freeBytes -= length;
+    return offset;
+}
+
+static void trimHeapTail()
+{
+    while (!freeByOffset.empty())
+    {
+        auto last = std::prev(freeByOffset.end());
+        if (last->first + last->second != heapEnd)
+            break;
+        heapEnd = last->first;
+        freeBytes -= last->second;
+        removeFreeExtent(last);
+    }
+}
+
+static void rebuildFreeSpace()
+{
+    freeByOffset.clear();
+    freeBySize.clear();
+    freeBytes = 0;
+    freeSlots.clear();
+
+    vector<pair<uint64_t, uint64_t>> used;
+    for (size_t i = 0; i < slotTable.size(); i++)
+    {
+        const BinaryStoreSlot &slot = slotTable[i];
+        if (!slot.live)
+            freeSlots.push_back(i);
+        else if (binarySlotBlockLength(slot) > 0)
+            used.emplace_back(slot.offset, binarySlotBlockLength(slot));
+    }
+    sort(used.begin(), used.end());
+    uint64_t cursor = binarySlotOffset(slotCapacity);
+    for (const auto &extent : used)
+    {
+        if (extent.first > cursor)
+            releaseExtent(cursor, extent.first - cursor);
+        cursor = max(cursor, extent.first + extent.second);
+    }
+    if (cursor < heapEnd)
+        releaseExtent(cursor, heapEnd - cursor);
+}
+
+static void loadSlotTable(const char *data, size_t size)
+{
+    BinaryStoreHeader header;
+    memcpy(&header, data, sizeof(header));
+    slotCapacity = header.slotCapacity;
+    slotTable.resize(header.slotCount);
+    memcpy(slotTable.data(), data + binarySlotOffset(0), header.slotCount * sizeof(BinaryStoreSlot));
+    heapEnd = size;
+    rebuildFreeSpace();
+    tableLoaded = true;
+}
+
+static bool readSlotTable()
+{
+    ifstream in(storePath, ios::binary);
+    BinaryStoreHeader header;
+    if (!in || !readBinaryStoreHeader(in, header) || !headerValid(header, storeSize))
+        return false;
+    slotCapacity = header.slotCapacity;
+    slotTable.resize(header.slotCount);
+    in.read((char *)slotTable.data(), header.slotCount * sizeof(BinaryStoreSlot));
+    if (!in)
+        return false;
+    heapEnd = storeSize;
+    rebuildFreeSpace();
+    tableLoaded = true;
+    return true;
+}
+
+void bindBinaryStore(const string &path, const Student *arr, const vector<int> &slots, const char *data, size_t size)
+{
+    unbindBinaryStore();
+    storeBound = true;
+    storePath = path;
+    stampStore();
+    for (size_t i = 0; i < slots.size(); i++)
+        slotOfId[arr[i].id] = slots[i];
+    if (data)
+        loadSlotTable(data, size);
+}
+
+void unbindBinaryStore()
+{
+    storeBound = false;
+    storePath.clear();
+    tableLoaded = false;
+    slotCapacity = 0;
+    slotTable.clear();
+    freeSlots.clear();
+    heapEnd = 0;
+    freeByOffset.clear();
+    freeBySize.clear();
+    freeBytes = 0;
+    slotOfId.clear();
+    dirtyIds.clear();
+    erasedSlots.clear();
+}
+
+int binaryStoreSlotOf(uint64_t id)
+{
+    auto found = slotOfId.find(id);
+    return found == slotOfId.end() ? -1 : found->second;
+}
+
+bool binaryStoreBoundTo(const string &path)
+{
+    return storeBound && storePath == path;
+}
+
+void binaryStoreMarkDirty(uint64_t id)
+{
+    dirtyIds.insert(id);
+}
+
+void binaryStoreMarkErased(uint64_t id)
+{
+    dirtyIds.erase(id);
+    auto found = slotOfId.find(id);
+    if (found == slotOfId.end())
+        return;
+    erasedSlots.push_back(found->second);
+    slotOfId.erase(found);
+}
+
+size_t binaryStoreDirtyCount()
+{
+    return dirtyIds.size() + erasedSlots.size();
+}
+
+static bool canSaveIncrementally(const string &path)
+{
+    if (!storeBound || storePath != path || !storeUnchanged())
+        return false;
+    if (!tableLoaded && !readSlotTable())
+        return false;
+
+    size_t added = 0;
+    for (uint64_t id : dirtyIds)
+    {
+        if (!slotOfId.count(id))
+            added++;
+    }
+    size_t spare = freeSlots.size() + erasedSlots.size() + (slotCapacity - slotTable.size());
+    if (added > spare)
+        return false;
+    uint64_t heap = heapEnd - binarySlotOffset(slotCapacity);
+    return freeBytes <= heap * BINARY_STORE_GARBAGE_RATIO;
+}
+
+// Points slot at room for a length-byte block. The old extent is reused while the
+// block still fits; otherwise the new one is allocated before the old is freed,
+// so the block never overwrites the record it replaces.
+static void placeBlock(BinaryStoreSlot &slot, const BinaryStoreSlot &old, uint64_t length)
+{
+    uint64_t oldLength = binarySlotBlockLength(old);
+    if (length <= oldLength)
+    {
+        slot.offset = old.offset;
+        releaseExtent(old.offset + length, oldLength - length);
+    }
+    else
+    {
+        slot.offset = allocateExtent(length);
+        releaseExtent(old.offset, oldLength);
+    }
+}
+
+static bool saveIncremental(const string &path, const Student *arr, uint32_t generation, BinarySaveStats &stats)
+{
+    fstream file(path, ios::binary | ios::in | ios::out);
+    if (!file)
+        return false;
+
+    stats = {true, 0, 0};
+    auto writeAt = [&](uint64_t offset, const void *data, size_t n) {
+        file.seekp(offset);
+        file.write((const char *)data, n);
+        stats.bytes += n;
+    };
+
+    for (int index : erasedSlots)
+    {
+        BinaryStoreSlot &slot = slotTable[index];
+        releaseExtent(slot.offset, binarySlotBlockLength(slot));
+        slot = BinaryStoreSlot();
+        writeAt(binarySlotOffset(index), &slot, sizeof(slot));
+        freeSlots.push_back(index);
+        stats.records++;
+    }
+
+    string block;
+    for (uint64_t id : dirtyIds)
+    {
+        int position = positionOfStudentId(id);
+        if (position < 0)
+            continue;
+        BinaryStoreSlot slot = makeSlot(arr[position]);
+        block.clear();
+        appendBlock(arr[position], block);
+
+        int index;
+        auto found = slotOfId.find(id);
+        if (found != slotOfId.end())
+        {
+            index = found->second;
+            placeBlock(slot, slotTable[index], block.size());
+        }
+        else
+        {
+            if (!freeSlots.empty())
+            {
+                index = freeSlots.back();
+                freeSlots.pop_back();
+            }
+            else
+            {
+                index = slotTable.size();
+                slotTable.emplace_back();
+            }
+            slot.offset = allocateExtent(block.size());
+            slotOfId[id] = index;
+        }
+        slotTable[index] = slot;
+        writeAt(slot.offset, block.data(), block.size());
+        writeAt(binarySlotOffset(index), &slot, sizeof(slot));
+        stats.records++;
+    }
+
+    BinaryStoreHeader header = makeHeader(slotCapacity, slotTable.size(), generation);
+    writeAt(0, &header, sizeof(header));
+    file.close();
+    if (!file)
+        return false;
+
+    trimHeapTail();
+    error_code ec;
+    if (heapEnd < filesystem::file_size(path, ec) && !ec)
+        filesystem::resize_file(path, heapEnd, ec);
+    stampStore();
+    dirtyIds.clear();
+    erasedSlots.clear();
+    return true;
+}
+
+static bool saveFull(const string &path, const Student *arr, int count, uint32_t generation, BinarySaveStats &stats)
+{
+    string tmpPath = path + ".tmp";
+    ofstream out(tmpPath, ios::binary | ios::trunc);
+    if (!out)
+        return false;
+
+    vector<BinaryStoreSlot> table;
+    for (int i = 0; i < count; i++)
+    {
+        if (arr[i].id != INVALID_STUDENT_ID)
+            table.push_back(makeSlot(arr[i]));
+    }
+    int64_t capacity = table.size() + table.size() / 2 + BINARY_STORE_MIN_HEADROOM;
+    uint64_t offset = binarySlotOffset(capacity);
+    for (BinaryStoreSlot &slot : table)
+    {
+        slot.offset = offset;
+        offset += binarySlotBlockLength(slot);
+    }
+
+    BinaryStoreHeader header = makeHeader(capacity, table.size(), generation);
+    out.write((char *)&header, sizeof(header));
+    out.write((char *)table.data(), table.size() * sizeof(BinaryStoreSlot));
+    vector<char> spare((capacity - table.size()) * sizeof(BinaryStoreSlot), 0);
+    out.write(spare.data(), spare.size());
+    string block;
+    for (int i = 0; i < count; i++)
+    {
+        if (arr[i].id == INVALID_STUDENT_ID)
+            continue;
+        block.clear();
+        appendBlock(arr[i], block);
+        out.write(block.data(), block.size());
+    }
+    out.close();
+
+    error_code ec;
+    if (!out)
+    {
+        filesystem::remove(tmpPath, ec);
+        return false;
+    }
+    filesystem::rename(tmpPath, path, ec);
+    if (ec)
+        return false;
+
+    unbindBinaryStore();
+    storeBound = true;
+    storePath = path;
+    stampStore();
+    slotCapacity = capacity;
+    slotTable = move(table);
+    heapEnd = offset;
+    tableLoaded = true;
+    int slot = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (arr[i].id != INVALID_STUDENT_ID)
+            slotOfId[arr[i].id] = slot++;
+    }
+    stats = {false, (long long)slotTable.size(), (long long)offset};
+    return true;
+}
+
+bool saveBinaryStore(const string &path, const Student *arr, int count, uint32_t generation, BinarySaveStats &stats)
+{
+    if (canSaveIncrementally(path))
+    {
+        if (saveIncremental(path, arr, generation, stats))
+            return true;
+        unbindBinaryStore();
+    }
+    return saveFull(path, arr, count, generation, stats);
+}
+
+bool rewriteBinarySlots(const string &path, const vector<pair<int64_t, const Student *>> &records, long long &bytes)
+{
+    unbindBinaryStore();
+    storePath = path;
+    stampStore();
+    fstream file(path, ios::binary | ios::in | ios::out);
+    BinaryStoreHeader header;
+    bool ok = file && readBinaryStoreHeader(file, header) && readSlotTable();
+    string block;
+    for (size_t r = 0; ok && r < records.size(); r++)
+    {
+        int64_t index = records[r].first;
+        if (index < 0 || index >= (int64_t)slotTable.size() || !slotTable[index].live)
+        {
+            ok = false;
+            break;
+        }
+        BinaryStoreSlot slot = makeSlot(*records[r].second);
+        block.clear();
+        appendBlock(*records[r].second, block);
+        placeBlock(slot, slotTable[index], block.size());
+        slotTable[index] = slot;
+        file.seekp(slot.offset);
+        file.write(block.data(), block.size());
+        file.seekp(binarySlotOffset(index));
+        file.write((char *)&slot, sizeof(slot));
+        bytes += block.size() + sizeof(slot);
+    }
+    if (ok)
+    {
+        header = makeHeader(slotCapacity, slotTable.size(), header.generation + 1);
+        file.seekp(0);
+        file.write((char *)&header, sizeof(header));
+    }
+    file.close();
+    ok = ok && (bool)file;
+
+    if (ok)
+    {
+        trimHeapTail();
+        error_code ec;
+        if (heapEnd < filesystem::file_size(path, ec) && !ec)
+            filesystem::resize_file(path, heapEnd, ec);
+    }
+    unbindBinaryStore();
+    return ok;
+}
+
+size_t binaryStoreTableBytes()
+{
+    return vectorBytes(slotTable) + vectorBytes(freeSlots) + nodeTableBytes(freeByOffset) +
+           nodeTableBytes(freeBySize) + hashTableBytes(slotOfId) + hashTableBytes(dirtyIds) +
+           vectorBytes(erasedSlots);
+}
@@ -0,0 +1,67 @@
+#ifndef UTP_BINARYSTORE_H
+#define UTP_BINARYSTORE_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "Student.h"
+
+const int BINARY_STORE_VERSION = 3;
+const int BINARY_STORE_FIELDS = 4;
+const double BINARY_STORE_GARBAGE_RATIO = 0.5;
+
+struct BinaryStoreHeader
+{
+    char magic[8];
+    std::int32_t slotSize;
+    std::uint32_t generation;
+    std::int64_t slotCapacity;
+    std::int64_t slotCount;
+};
+
+struct BinaryStoreSlot
+{
+    std::int32_t live;
+    std::int32_t year;
+    std::int32_t course;
+    std::uint32_t lengths[BINARY_STORE_FIELDS];
+    std::uint64_t offset;
+};
+
+struct BinarySaveStats
+{
+    bool incremental;
+    long long records;
+    long long bytes;
+};
+
+bool isBinaryStore(const char *data, size_t size);
+int binaryStoreVersion(const char *data, size_t size);
+bool readBinaryStoreHeader(std::istream &in, BinaryStoreHeader &header);
+std::uint32_t binaryStoreGeneration(const std::string &path);
+std::uint64_t binarySlotOffset(std::int64_t slot);
+std::uint64_t binarySlotBlockLength(const BinaryStoreSlot &slot);
+bool decodeBinarySlot(const BinaryStoreSlot &slot, const char *block, Student &student);
+
+int binaryStoreLiveCount(const char *data, size_t size);
+bool decodeBinaryStore(const char *data, size_t size, Student *arr, int count, std::vector<int> &slots);
+void bindBinaryStore(const std::string &path, const Student *arr, const std::vector<int> &slots,
+                     const char *data, size_t size);
+void unbindBinaryStore();
+int binaryStoreSlotOf(std::uint64_t id);
+bool binaryStoreBoundTo(const std::string &path);
+
+void binaryStoreMarkDirty(std::uint64_t id);
+void binaryStoreMarkErased(std::uint64_t id);
+size_t binaryStoreDirtyCount();
+size_t binaryStoreTableBytes();
+
+bool saveBinaryStore(const std::string &path, const Student *arr, int count, std::uint32_t generation,
+                     BinarySaveStats &stats);
+// Lazy-mode save of edited records, keyed by slot index. Free extents come from
+// the file's own slot table, and the header generation is bumped.
+bool rewriteBinarySlots(const std::string &path, const std::vector<std::pair<std::int64_t, const Student *>> &records,
+                        long long &bytes);
+
+#endif
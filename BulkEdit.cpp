@@ -0,0 +1,375 @@
+#include "BulkEdit.h"
+#include "SurnameIndex.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+using namespace std;
+
+struct BulkToken
+{
+    string text;
+    bool quoted;
+    bool op;
+};
+
+struct BulkFieldName
+{
+    const char *english;
+    const char *russian;
+    BulkField field;
+};
+
+static const BulkFieldName FIELD_NAMES[] = {
+    {"year", "год", BULK_YEAR},
+    {"course", "курс", BULK_COURSE},
+    {"name", "имя", BULK_NAME},
+    {"surname", "фамилия", BULK_SURNAME},
+    {"middlename", "отчество", BULK_MIDDLE_NAME}};
+
+static bool isOperatorChar(char c)
+{
+    return c == '=' || c == '!' || c == '<' || c == '>' || c == '^' || c == '+' || c == '-';
+}
+
+static bool tokenize(const string &line, vector<BulkToken> &tokens, string &error)
+{
+    size_t i = 0;
+    while (i < line.size())
+    {
+        char c = line[i];
+        if (c == ' ' || c == '\t')
+        {
+            i++;
+            continue;
+        }
+        if (c == '"')
+        {
+            size_t end = line.find('"', i + 1);
+            if (end == string::npos)
+            {
+                error = "незакрытая кавычка";
+                return false;
+            }
+            tokens.push_back({line.substr(i + 1, end - i - 1), true, false});
+            i = end + 1;
+            continue;
+        }
+        if (isOperatorChar(c))
+        {
+            size_t len = i + 1 < line.size() && line[i + 1] == '=' && c != '=' ? 2 : 1;
+            tokens.push_back({line.substr(i, len), false, true});
+            i += len;
+            continue;
+        }
+        size_t start = i;
+        while (i < line.size() && line[i] != ' ' && line[i] != '\t' && line[i] != '"' && !isOperatorChar(line[i]))
+            i++;
+        tokens.push_back({line.substr(start, i - start), false, false});
+    }
+    return true;
+}
+
+static bool isKeyword(const BulkToken &token, const char *english, const char *russian)
+{
+    if (token.quoted || token.op)
+        return false;
+    string folded = foldCase(token.text);
+    return folded == english || folded == russian;
+}
+
+static bool parseField(const BulkToken &token, BulkField &field)
+{
+    for (const BulkFieldName &name : FIELD_NAMES)
+    {
+        if (isKeyword(token, name.english, name.russian))
+        {
+            field = name.field;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool parseNumber(const string &text, int &number)
+{
+    if (text.empty() || text.size() > 9)
+        return false;
+    for (char c : text)
+    {
+        if (c < '0' || c > '9')
+            return false;
+    }
+    number = stoi(text);
+    return true;
+}
+
+static bool parseCompare(const string &op, BulkCompare &compare)
+{
+    static const pair<const char *, BulkCompare> OPS[] = {
+        {"=", BULK_EQ}, {"!=", BULK_NE}, {"<", BULK_LT}, {"<=", BULK_LE},
+        {">", BULK_GT}, {">=", BULK_GE}, {"^=", BULK_PREFIX}};
+    for (const auto &entry : OPS)
+    {
+        if (op == entry.first)
+        {
+            compare = entry.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool parseValue(const BulkToken &token, BulkField field, string &text, int &number, string &error)
+{
+    if (token.op)
+    {
+        error = "ожидалось значение, а не \"" + token.text + "\"";
+        return false;
+    }
+    if (bulkFieldIsNumber(field))
+    {
+        if (!parseNumber(token.text, number))
+        {
+            error = "\"" + token.text + "\" не является числом";
+            return false;
+        }
+        return true;
+    }
+    text = token.text;
+    return true;
+}
+
+static bool parseWhere(const vector<BulkToken> &tokens, size_t pos, BulkCommand &command, string &error)
+{
+    if (pos >= tokens.size() || !isKeyword(tokens[pos], "where", "где"))
+    {
+        error = "ожидалось where <условие> (для всех записей: where all)";
+        return false;
+    }
+    pos++;
+    if (pos + 1 == tokens.size() && isKeyword(tokens[pos], "all", "все"))
+        return true;
+
+    while (true)
+    {
+        if (pos + 3 > tokens.size())
+        {
+            error = "неполное условие";
+            return false;
+        }
+        BulkCondition condition;
+        if (!parseField(tokens[pos], condition.field))
+        {
+            error = "неизвестное поле \"" + tokens[pos].text + "\"";
+            return false;
+        }
+        if (!tokens[pos + 1].op || !parseCompare(tokens[pos + 1].text, condition.compare))
+        {
+            error = "неизвестная операция \"" + tokens[pos + 1].text + "\"";
+            return false;
+        }
+        bool number = bulkFieldIsNumber(condition.field);
+        if (number && condition.compare == BULK_PREFIX)
+        {
+            error = "^= применимо только к строковым полям";
+            return false;
+        }
+        if (!number && condition.compare != BULK_EQ && condition.compare != BULK_NE && condition.compare != BULK_PREFIX)
+        {
+            error = "строковые поля сравниваются только через =, != или ^=";
+            return false;
+        }
+        condition.number = 0;
+        if (!parseValue(tokens[pos + 2], condition.field, condition.text, condition.number, error))
+            return false;
+        condition.text = foldCase(condition.text);
+        command.where.push_back(condition);
+        pos += 3;
+
+        if (pos == tokens.size())
+            return true;
+        if (!isKeyword(tokens[pos], "and", "и"))
+        {
+            error = "ожидалось and, получено \"" + tokens[pos].text + "\"";
+            return false;
+        }
+        pos++;
+    }
+}
+
+static bool parseAssignment(const vector<BulkToken> &tokens, size_t &pos, BulkCommand &command, string &error)
+{
+    if (pos + 3 > tokens.size() || !parseField(tokens[pos], command.target))
+    {
+        error = "ожидалось update <поле> = <значение> where <условие>";
+        return false;
+    }
+    bool number = bulkFieldIsNumber(command.target);
+    const string &op = tokens[pos + 1].op ? tokens[pos + 1].text : string();
+    if (op == "+=" || op == "-=")
+    {
+        if (!number || !parseNumber(tokens[pos + 2].text, command.delta))
+        {
+            error = op + " применимо только к числовым полям с числом справа";
+            return false;
+        }
+        if (op == "-=")
+            command.delta = -command.delta;
+        command.relative = true;
+        pos += 3;
+        return true;
+    }
+    if (op != "=")
+    {
+        error = "ожидалось = после имени поля";
+        return false;
+    }
+
+    BulkField source;
+    if (number && pos + 5 <= tokens.size() && parseField(tokens[pos + 2], source) && source == command.target &&
+        tokens[pos + 3].op && (tokens[pos + 3].text == "+" || tokens[pos + 3].text == "-"))
+    {
+        if (!parseNumber(tokens[pos + 4].text, command.delta))
+        {
+            error = "\"" + tokens[pos + 4].text + "\" не является числом";
+            return false;
+        }
+        if (tokens[pos + 3].text == "-")
+            command.delta = -command.delta;
+        command.relative = true;
+        pos += 5;
+        return true;
+    }
+    if (!parseValue(tokens[pos + 2], command.target, command.text, command.number, error))
+        return false;
+    pos += 3;
+    return true;
+}
+
+bool parseBulkCommand(const string &line, BulkCommand &command, string &error)
+{
+    command = BulkCommand();
+    command.remove = false;
+    command.target = BULK_YEAR;
+    command.delta = 0;
+    command.relative = false;
+    command.number = 0;
+
+    vector<BulkToken> tokens;
+    if (!tokenize(line, tokens, error))
+        return false;
+    if (tokens.empty())
+    {
+        error = "пустая команда";
+        return false;
+    }
+
+    size_t pos = 1;
+    if (isKeyword(tokens[0], "delete", "удалить"))
+    {
+        command.remove = true;
+    }
+    else if (isKeyword(tokens[0], "update", "изменить"))
+    {
+        if (!parseAssignment(tokens, pos, command, error))
+            return false;
+    }
+    else
+    {
+        error = "команда должна начинаться с delete или update";
+        return false;
+    }
+    return parseWhere(tokens, pos, command, error);
+}
+
+bool bulkFieldIsNumber(BulkField field)
+{
+    return field == BULK_YEAR || field == BULK_COURSE;
+}
+
+static string_view textField(const Student &student, BulkField field)
+{
+    if (field == BULK_NAME)
+        return student.name;
+    if (field == BULK_SURNAME)
+        return student.surname;
+    return student.middleName;
+}
+
+static bool conditionHolds(const BulkCondition &condition, const Student &student)
+{
+    if (bulkFieldIsNumber(condition.field))
+    {
+        int value = condition.field == BULK_YEAR ? student.year : student.course;
+        switch (condition.compare)
+        {
+        case BULK_EQ:
+            return value == condition.number;
+        case BULK_NE:
+            return value != condition.number;
+        case BULK_LT:
+            return value < condition.number;
+        case BULK_LE:
+            return value <= condition.number;
+        case BULK_GT:
+            return value > condition.number;
+        case BULK_GE:
+            return value >= condition.number;
+        default:
+            return false;
+        }
+    }
+
+    string value = foldCase(textField(student, condition.field));
+    if (condition.compare == BULK_PREFIX)
+        return value.compare(0, condition.text.size(), condition.text) == 0;
+    return (value == condition.text) == (condition.compare == BULK_EQ);
+}
+
+bool bulkMatches(const BulkCommand &command, const Student &student)
+{
+    for (const BulkCondition &condition : command.where)
+    {
+        if (!conditionHolds(condition, student))
+            return false;
+    }
+    return true;
+}
+
+vector<char> bulkSelect(const BulkCommand &command, const Student *arr, int count)
+{
+    vector<char> selected(count, 0);
+    auto scan = [&](size_t from, size_t to) {
+        for (size_t i = from; i < to; i++)
+            selected[i] = bulkMatches(command, arr[i]);
+    };
+
+    if (count < BULK_PARALLEL_THRESHOLD)
+        scan(0, count);
+    else
+        parallelFor(0, count, PARALLEL_FOR_GRAIN, scan);
+    return selected;
+}
+
+void bulkApply(const BulkCommand &command, Student &student)
+{
+    switch (command.target)
+    {
+    case BULK_YEAR:
+        student.year = command.relative ? student.year + command.delta : command.number;
+        break;
+    case BULK_COURSE:
+        student.course = command.relative ? student.course + command.delta : command.number;
+        break;
+    case BULK_NAME:
+        student.name = command.text;
+        break;
+    case BULK_SURNAME:
+        student.surname = command.text;
+        break;
+    case BULK_MIDDLE_NAME:
+        student.middleName = command.text;
+        break;
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef UTP_BULKEDIT_H
+#define UTP_BULKEDIT_H
+
+#include <string>
+#include <vector>
+#include "Student.h"
+
+const int BULK_PARALLEL_THRESHOLD = 32768;
+
+enum BulkField
+{
+    BULK_YEAR,
+    BULK_COURSE,
+    BULK_NAME,
+    BULK_SURNAME,
+    BULK_MIDDLE_NAME
+};
+
+enum BulkCompare
+{
+    BULK_EQ,
+    BULK_NE,
+    BULK_LT,
+    BULK_LE,
+    BULK_GT,
+    BULK_GE,
+    BULK_PREFIX
+};
+
+struct BulkCondition
+{
+    BulkField field;
+    BulkCompare compare;
+    std::string text;
+    int number;
+};
+
+struct BulkCommand
+{
+    bool remove;
+    std::vector<BulkCondition> where;
+    BulkField target;
+    int delta;
+    bool relative;
+    std::string text;
+    int number;
+};
+
+bool parseBulkCommand(const std::string &line, BulkCommand &command, std::string &error);
+bool bulkFieldIsNumber(BulkField field);
+bool bulkMatches(const BulkCommand &command, const Student &student);
+std::vector<char> bulkSelect(const BulkCommand &command, const Student *arr, int count);
+void bulkApply(const BulkCommand &command, Student &student);
+
+#endif
@@ -0,0 +1,594 @@
+#include "ChangeLog.h"
+#include "SlotMap.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <unordered_map>
+
+using namespace std;
+
+const char CHANGE_CHECKPOINT_MAGIC[8] = {'U', 'T', 'P', 'C', 'H', 'K', '2', '\0'};
+const char CHANGE_CHECKPOINT_V1_MAGIC[8] = {'U', 'T', 'P', 'C', 'H', 'K', '1', '\0'};
+const char *const CHANGE_ARCHIVE_SUFFIX = ".v1";
+
+static const char *CHANGE_FIELD_NAMES[CHANGE_FIELDS] = {
+    "год", "курс", "имя", "фамилия", "отчество", "предметы и оценки"};
+
+struct ChangeEventHeader
+{
+    uint32_t length;
+    uint16_t type;
+    uint16_t mask;
+    uint64_t sequence;
+    int64_t timestamp;
+    uint64_t digest;
+};
+
+struct ChangeCheckpointHeader
+{
+    char magic[8];
+    uint64_t sequence;
+    int64_t timestamp;
+    uint64_t digest;
+    int64_t count;
+};
+
+static bool logOpen = false;
+static string logDir;
+static uint64_t headSequence = 0;
+static uint64_t headDigest = 0;
+static uint64_t checkpointSequence = 0;
+static uint64_t eventsSinceCheckpoint = 0;
+static ofstream segment;
+
+static int64_t nowMillis()
+{
+    return chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static string sequencePath(const char *prefix, uint64_t sequence, const char *suffix)
+{
+    string number = to_string(sequence);
+    return logDir + "/" + prefix + string(12 - min<size_t>(12, number.size()), '0') + number + suffix;
+}
+
+static string checkpointPath(uint64_t sequence)
+{
+    return sequencePath("checkpoint-", sequence, ".bin");
+}
+
+static string segmentPath(uint64_t sequence)
+{
+    return sequencePath("segment-", sequence, ".log");
+}
+
+static vector<uint64_t> listSequences(const string &prefix, const string &suffix)
+{
+    vector<uint64_t> sequences;
+    error_code ec;
+    for (const auto &entry : filesystem::directory_iterator(logDir, ec))
+    {
+        string name = entry.path().filename().string();
+        if (name.size() <= prefix.size() + suffix.size() || name.compare(0, prefix.size(), prefix) != 0 ||
+            name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0)
+            continue;
+        uint64_t sequence = 0;
+        const char *first = name.data() + prefix.size();
+        const char *last = name.data() + name.size() - suffix.size();
+        auto parsed = from_chars(first, last, sequence);
+        if (parsed.ec == errc() && parsed.ptr == last)
+            sequences.push_back(sequence);
+    }
+    sort(sequences.begin(), sequences.end());
+    return sequences;
+}
+
+static void studentFields(const Student &student, string fields[CHANGE_FIELDS])
+{
+    fields[0] = to_string(student.year);
+    fields[1] = to_string(student.course);
+    fields[2] = student.name.str();
+    fields[3] = student.surname.str();
+    fields[4] = student.middleName.str();
+    fields[5] = string(student.subjects.encoded());
+}
+
+static void appendField(string &out, string_view field)
+{
+    uint32_t length = field.size();
+    out.append((const char *)&length, sizeof(length));
+    out.append(field);
+}
+
+static string encodeFields(const string fields[CHANGE_FIELDS])
+{
+    string record;
+    for (int f = 0; f < CHANGE_FIELDS; f++)
+        appendField(record, fields[f]);
+    return record;
+}
+
+static bool takeField(string_view &in, string_view &field)
+{
+    uint32_t length = 0;
+    if (in.size() < sizeof(length))
+        return false;
+    memcpy(&length, in.data(), sizeof(length));
+    in.remove_prefix(sizeof(length));
+    if (in.size() < length)
+        return false;
+    field = in.substr(0, length);
+    in.remove_prefix(length);
+    return true;
+}
+
+static bool decodeFields(string_view &in, string_view fields[CHANGE_FIELDS])
+{
+    for (int f = 0; f < CHANGE_FIELDS; f++)
+    {
+        if (!takeField(in, fields[f]))
+            return false;
+    }
+    return true;
+}
+
+static string encodeStudent(const Student &student)
+{
+    string fields[CHANGE_FIELDS];
+    studentFields(student, fields);
+    return encodeFields(fields);
+}
+
+static uint64_t recordHash(string_view record)
+{
+    uint64_t hash = 1469598103934665603ULL;
+    for (unsigned char c : record)
+    {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+static uint64_t rosterDigest(const Student *arr, int count)
+{
+    uint64_t digest = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (arr[i].id != INVALID_STUDENT_ID)
+            digest += recordHash(encodeStudent(arr[i]));
+    }
+    return digest;
+}
+
+bool decodeChangeRecord(string_view record, Student &student)
+{
+    string_view fields[CHANGE_FIELDS];
+    if (!decodeFields(record, fields))
+        return false;
+    if (from_chars(fields[0].data(), fields[0].data() + fields[0].size(), student.year).ec != errc() ||
+        from_chars(fields[1].data(), fields[1].data() + fields[1].size(), student.course).ec != errc())
+        return false;
+    student.name = fields[2];
+    student.surname = fields[3];
+    student.middleName = fields[4];
+    return SubjectList::view(fields[5], student.subjects);
+}
+
+const char *changeFieldName(int field)
+{
+    return field >= 0 && field < CHANGE_FIELDS ? CHANGE_FIELD_NAMES[field] : "";
+}
+
+static bool decodeEvent(const ChangeEventHeader &header, string_view payload, ChangeEvent &event)
+{
+    event.sequence = header.sequence;
+    event.timestamp = header.timestamp;
+    event.type = (ChangeType)header.type;
+    event.mask = header.mask;
+    event.before.clear();
+    event.after.clear();
+    switch (event.type)
+    {
+    case CHANGE_INSERT:
+        event.after = string(payload);
+        return true;
+    case CHANGE_DELETE:
+        event.before = string(payload);
+        return true;
+    case CHANGE_RESET:
+        return true;
+    case CHANGE_UPDATE:
+    {
+        string_view rest = payload;
+        string_view before[CHANGE_FIELDS];
+        if (!decodeFields(rest, before))
+            return false;
+        event.before = string(payload.substr(0, payload.size() - rest.size()));
+        string after[CHANGE_FIELDS];
+        for (int f = 0; f < CHANGE_FIELDS; f++)
+        {
+            string_view field = before[f];
+            if ((header.mask & (1 << f)) && !takeField(rest, field))
+                return false;
+            after[f] = string(field);
+        }
+        event.after = encodeFields(after);
+        return true;
+    }
+    }
+    return false;
+}
+
+static uint64_t readEvents(const string &path, const function<bool(const ChangeEventHeader &, string_view)> &visit)
+{
+    ifstream in(path, ios::binary);
+    uint64_t good = 0;
+    ChangeEventHeader header;
+    string payload;
+    while (in.read((char *)&header, sizeof(header)))
+    {
+        payload.resize(header.length);
+        if (!in.read(payload.data(), payload.size()))
+            break;
+        good += sizeof(header) + header.length;
+        if (!visit(header, payload))
+            break;
+    }
+    return good;
+}
+
+static bool readCheckpointHeader(ifstream &in, ChangeCheckpointHeader &header)
+{
+    return in.read((char *)&header, sizeof(header)) &&
+           memcmp(header.magic, CHANGE_CHECKPOINT_MAGIC, sizeof(header.magic)) == 0;
+}
+
+// Logs written before subject lists became variable keep eleven fixed fields per record;
+// they are moved aside whole rather than converted, so their history stays readable by hand.
+static bool archiveOlderLog(const string &path)
+{
+    ifstream in(path, ios::binary);
+    ChangeCheckpointHeader header;
+    if (!in.read((char *)&header, sizeof(header)) ||
+        memcmp(header.magic, CHANGE_CHECKPOINT_V1_MAGIC, sizeof(header.magic)) != 0)
+        return false;
+    in.close();
+    error_code ec;
+    filesystem::rename(logDir, logDir + CHANGE_ARCHIVE_SUFFIX, ec);
+    return !ec;
+}
+
+static bool writeCheckpointFile(const Student *arr, int count)
+{
+    string path = checkpointPath(headSequence);
+    string tmpPath = path + ".tmp";
+    ofstream out(tmpPath, ios::binary | ios::trunc);
+    if (!out)
+        return false;
+
+    ChangeCheckpointHeader header = {};
+    memcpy(header.magic, CHANGE_CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.sequence = headSequence;
+    header.timestamp = nowMillis();
+    header.digest = headDigest;
+    for (int i = 0; i < count; i++)
+        header.count += arr[i].id != INVALID_STUDENT_ID;
+    out.write((char *)&header, sizeof(header));
+
+    string record;
+    for (int i = 0; i < count; i++)
+    {
+        if (arr[i].id == INVALID_STUDENT_ID)
+            continue;
+        record.clear();
+        appendField(record, encodeStudent(arr[i]));
+        out.write(record.data(), record.size());
+    }
+    out.close();
+
+    error_code ec;
+    if (!out)
+    {
+        filesystem::remove(tmpPath, ec);
+        return false;
+    }
+    filesystem::rename(tmpPath, path, ec);
+    return !ec;
+}
+
+static void openSegment()
+{
+    segment.close();
+    segment.clear();
+    segment.open(segmentPath(checkpointSequence), ios::binary | ios::app);
+}
+
+bool openChangeLog(const string &dir)
+{
+    if (logOpen && logDir == dir)
+        return true;
+    segment.close();
+    logOpen = false;
+    logDir = dir;
+    error_code ec;
+    filesystem::create_directories(dir, ec);
+    if (ec)
+        return false;
+
+    vector<uint64_t> checkpoints = listSequences("checkpoint-", ".bin");
+    headSequence = 0;
+    headDigest = 0;
+    eventsSinceCheckpoint = 0;
+    if (checkpoints.empty())
+    {
+        if (!writeCheckpointFile(nullptr, 0))
+            return false;
+        checkpointSequence = 0;
+    }
+    else
+    {
+        checkpointSequence = checkpoints.back();
+        ifstream in(checkpointPath(checkpointSequence), ios::binary);
+        ChangeCheckpointHeader header;
+        if (!readCheckpointHeader(in, header))
+        {
+            in.close();
+            return archiveOlderLog(checkpointPath(checkpointSequence)) && openChangeLog(dir);
+        }
+        headSequence = header.sequence;
+        headDigest = header.digest;
+
+        string path = segmentPath(checkpointSequence);
+        uint64_t good = readEvents(path, [](const ChangeEventHeader &event, string_view) {
+            headSequence = event.sequence;
+            headDigest = event.digest;
+            eventsSinceCheckpoint++;
+            return true;
+        });
+        if (filesystem::exists(path) && filesystem::file_size(path, ec) > good)
+            filesystem::resize_file(path, good, ec);
+    }
+
+    openSegment();
+    logOpen = (bool)segment;
+    return logOpen;
+}
+
+bool changeLogOpen()
+{
+    return logOpen;
+}
+
+uint64_t changeLogHead()
+{
+    return headSequence;
+}
+
+static void writeEvent(ChangeType type, uint16_t mask, const string &payload, uint64_t digest)
+{
+    ChangeEventHeader header;
+    header.length = payload.size();
+    header.type = type;
+    header.mask = mask;
+    header.sequence = headSequence + 1;
+    header.timestamp = nowMillis();
+    header.digest = digest;
+    segment.write((char *)&header, sizeof(header));
+    segment.write(payload.data(), payload.size());
+    segment.flush();
+
+    headSequence = header.sequence;
+    headDigest = digest;
+    eventsSinceCheckpoint++;
+}
+
+bool syncChangeLog(const Student *arr, int count)
+{
+    if (!logOpen)
+        return false;
+    uint64_t digest = rosterDigest(arr, count);
+    if (digest == headDigest)
+        return false;
+    writeEvent(CHANGE_RESET, 0, string(), digest);
+    writeChangeCheckpoint(arr, count);
+    return true;
+}
+
+void appendChange(const Student *before, const Student *after)
+{
+    if (!logOpen || (!before && !after))
+        return;
+
+    if (!before)
+    {
+        string record = encodeStudent(*after);
+        writeEvent(CHANGE_INSERT, 0, record, headDigest + recordHash(record));
+        return;
+    }
+    string beforeFields[CHANGE_FIELDS];
+    studentFields(*before, beforeFields);
+    string beforeRecord = encodeFields(beforeFields);
+    if (!after)
+    {
+        writeEvent(CHANGE_DELETE, 0, beforeRecord, headDigest - recordHash(beforeRecord));
+        return;
+    }
+
+    string afterFields[CHANGE_FIELDS];
+    studentFields(*after, afterFields);
+    uint16_t mask = 0;
+    string payload = beforeRecord;
+    for (int f = 0; f < CHANGE_FIELDS; f++)
+    {
+        if (afterFields[f] == beforeFields[f])
+            continue;
+        mask |= 1 << f;
+        appendField(payload, afterFields[f]);
+    }
+    if (mask == 0)
+        return;
+    uint64_t digest = headDigest - recordHash(beforeRecord) + recordHash(encodeFields(afterFields));
+    writeEvent(CHANGE_UPDATE, mask, payload, digest);
+}
+
+bool changeCheckpointDue()
+{
+    return logOpen && eventsSinceCheckpoint >= CHANGE_CHECKPOINT_INTERVAL;
+}
+
+bool writeChangeCheckpoint(const Student *arr, int count)
+{
+    if (!logOpen)
+        return false;
+    if (checkpointSequence == headSequence)
+        return true;
+    if (!writeCheckpointFile(arr, count))
+        return false;
+    checkpointSequence = headSequence;
+    eventsSinceCheckpoint = 0;
+    openSegment();
+    return true;
+}
+
+int compactChangeLog(int keep)
+{
+    if (!logOpen)
+        return 0;
+    vector<uint64_t> checkpoints = listSequences("checkpoint-", ".bin");
+    if ((int)checkpoints.size() <= keep)
+        return 0;
+    uint64_t oldestKept = checkpoints[checkpoints.size() - keep];
+
+    int removed = 0;
+    error_code ec;
+    for (uint64_t sequence : checkpoints)
+    {
+        if (sequence < oldestKept && filesystem::remove(checkpointPath(sequence), ec))
+            removed++;
+    }
+    for (uint64_t sequence : listSequences("segment-", ".log"))
+    {
+        if (sequence < oldestKept && filesystem::remove(segmentPath(sequence), ec))
+            removed++;
+    }
+    return removed;
+}
+
+static void forEachEvent(uint64_t from, const function<bool(const ChangeEvent &)> &visit)
+{
+    vector<uint64_t> checkpoints = listSequences("checkpoint-", ".bin");
+    bool more = true;
+    ChangeEvent event;
+    for (uint64_t start : listSequences("segment-", ".log"))
+    {
+        if (!more)
+            break;
+        auto next = upper_bound(checkpoints.begin(), checkpoints.end(), start);
+        if (next != checkpoints.end() && *next <= from)
+            continue;
+        readEvents(segmentPath(start), [&](const ChangeEventHeader &header, string_view payload) {
+            if (header.sequence <= from)
+                return true;
+            if (!decodeEvent(header, payload, event))
+                return more = false;
+            return more = visit(event);
+        });
+    }
+}
+
+vector<ChangeEvent> recentChanges(int limit)
+{
+    vector<ChangeEvent> events;
+    uint64_t from = headSequence > (uint64_t)limit ? headSequence - limit : 0;
+    forEachEvent(from, [&](const ChangeEvent &event) {
+        events.push_back(event);
+        return true;
+    });
+    reverse(events.begin(), events.end());
+    return events;
+}
+
+bool changeSequenceAt(int64_t timestamp, uint64_t &sequence)
+{
+    bool found = false;
+    vector<uint64_t> checkpoints = listSequences("checkpoint-", ".bin");
+    if (!checkpoints.empty())
+    {
+        ifstream in(checkpointPath(checkpoints.front()), ios::binary);
+        ChangeCheckpointHeader header;
+        if (readCheckpointHeader(in, header) && header.timestamp <= timestamp)
+        {
+            sequence = header.sequence;
+            found = true;
+        }
+    }
+    forEachEvent(0, [&](const ChangeEvent &event) {
+        if (event.timestamp > timestamp)
+            return false;
+        sequence = event.sequence;
+        found = true;
+        return true;
+    });
+    return found;
+}
+
+bool changeStateAt(uint64_t sequence, vector<string> &records)
+{
+    records.clear();
+    if (!logOpen || sequence > headSequence)
+        return false;
+    vector<uint64_t> checkpoints = listSequences("checkpoint-", ".bin");
+    auto base = upper_bound(checkpoints.begin(), checkpoints.end(), sequence);
+    if (base == checkpoints.begin())
+        return false;
+    uint64_t start = *--base;
+
+    ifstream in(checkpointPath(start), ios::binary);
+    ChangeCheckpointHeader header;
+    if (!readCheckpointHeader(in, header))
+        return false;
+    unordered_map<string, int> state;
+    state.reserve(header.count);
+    for (int64_t i = 0; i < header.count; i++)
+    {
+        uint32_t length = 0;
+        if (!in.read((char *)&length, sizeof(length)))
+            return false;
+        string record(length, '\0');
+        if (!in.read(record.data(), length))
+            return false;
+        state[move(record)]++;
+    }
+
+    auto remove = [&](const string &record) {
+        auto found = state.find(record);
+        if (found != state.end() && --found->second == 0)
+            state.erase(found);
+    };
+    forEachEvent(start, [&](const ChangeEvent &event) {
+        if (event.sequence > sequence)
+            return false;
+        if (!event.before.empty())
+            remove(event.before);
+        if (!event.after.empty())
+            state[event.after]++;
+        return true;
+    });
+
+    for (auto &entry : state)
+    {
+        for (int i = 0; i < entry.second; i++)
+            records.push_back(entry.first);
+    }
+    sort(records.begin(), records.end());
+    return true;
+}
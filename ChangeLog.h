@@ -0,0 +1,48 @@
+#ifndef UTP_CHANGELOG_H
+#define UTP_CHANGELOG_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Student.h"
+
+const int CHANGE_FIELDS = 6;
+const std::uint64_t CHANGE_CHECKPOINT_INTERVAL = 1000;
+const int CHANGE_KEEP_CHECKPOINTS = 3;
+
+enum ChangeType
+{
+    CHANGE_INSERT = 1,
+    CHANGE_UPDATE,
+    CHANGE_DELETE,
+    CHANGE_RESET
+};
+
+struct ChangeEvent
+{
+    std::uint64_t sequence;
+    std::int64_t timestamp;
+    ChangeType type;
+    std::uint16_t mask;
+    std::string before;
+    std::string after;
+};
+
+bool openChangeLog(const std::string &dir);
+bool changeLogOpen();
+std::uint64_t changeLogHead();
+bool syncChangeLog(const Student *arr, int count);
+void appendChange(const Student *before, const Student *after);
+bool changeCheckpointDue();
+bool writeChangeCheckpoint(const Student *arr, int count);
+int compactChangeLog(int keep);
+
+std::vector<ChangeEvent> recentChanges(int limit);
+bool changeSequenceAt(std::int64_t timestamp, std::uint64_t &sequence);
+bool changeStateAt(std::uint64_t sequence, std::vector<std::string> &records);
+
+bool decodeChangeRecord(std::string_view record, Student &student);
+const char *changeFieldName(int field);
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef UTP_DISPLAYWIDTH_H
+#define UTP_DISPLAYWIDTH_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+const std::size_t DISPLAY_WIDTH_CACHE_LIMIT = 1 << 16;
+
+// Terminal columns taken by one code point: 0 for combining marks, format
+// characters and controls, 2 for East Asian wide and fullwidth characters
+// (emoji included), 1 otherwise.
+int codePointWidth(char32_t cp);
+
+// Terminal columns taken by a UTF-8 string. Pure ASCII/Cyrillic text is
+// counted directly; anything else is decoded once and its width cached.
+int displayWidth(std::string_view s);
+
+// Longest prefix of s, in bytes, that fits into width columns; combining
+// marks stay with the character before them.
+std::size_t widthPrefix(std::string_view s, int width, int &columns);
+std::vector<std::string> wrapToWidth(std::string_view s, int width);
+
+std::size_t displayWidthCacheBytes();
+
+#endif
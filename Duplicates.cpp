@@ -0,0 +1,322 @@
+#include "Duplicates.h"
+#include "Memory.h"
+#include "NameIndex.h"
+#include "SlotMap.h"
+#include "SurnameIndex.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+
+using namespace std;
+
+const size_t BLOCK_PREFIX = 2;
+const size_t BLOCK_GRAIN = 16;
+
+struct DuplicateProfile
+{
+    vector<int> members;
+    int year;
+    string surname;
+    string name;
+    string middleName;
+};
+
+static unordered_multimap<uint64_t, int> identities;
+static bool built = false;
+
+static void hashBytes(uint64_t &hash, string_view bytes)
+{
+    for (char c : bytes)
+    {
+        hash ^= (unsigned char)c;
+        hash *= 1099511628211ULL;
+    }
+}
+
+static uint64_t identityHash(const Student &student)
+{
+    uint64_t hash = 1469598103934665603ULL;
+    for (const InlineName *field : {&student.surname, &student.name, &student.middleName})
+    {
+        hashBytes(hash, foldCase(*field));
+        hashBytes(hash, string_view("\0", 1));
+    }
+    hashBytes(hash, string_view((const char *)&student.year, sizeof(student.year)));
+    return hash;
+}
+
+static vector<uint64_t> identityHashes(const Student *arr, int count)
+{
+    vector<uint64_t> hashes(count);
+    parallelFor(0, count, PARALLEL_FOR_GRAIN, [&](size_t from, size_t to) {
+        for (size_t i = from; i < to; i++)
+        {
+            if (arr[i].id != INVALID_STUDENT_ID)
+                hashes[i] = identityHash(arr[i]);
+        }
+    });
+    return hashes;
+}
+
+bool sameIdentity(const Student &a, const Student &b)
+{
+    return a.year == b.year && foldCase(a.surname) == foldCase(b.surname) && foldCase(a.name) == foldCase(b.name) &&
+           foldCase(a.middleName) == foldCase(b.middleName);
+}
+
+static int lookupIdentity(uint64_t hash, const Student &student, const Student *arr)
+{
+    auto range = identities.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (sameIdentity(arr[it->second], student))
+            return it->second;
+    }
+    return -1;
+}
+
+void resetIdentityIndex()
+{
+    identities.clear();
+    built = false;
+}
+
+// Returns how many live records repeat an identity already seen.
+int buildIdentityIndex(const Student *arr, int count)
+{
+    vector<uint64_t> hashes = identityHashes(arr, count);
+    identities.clear();
+    identities.reserve(count);
+    int duplicates = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (arr[i].id == INVALID_STUDENT_ID)
+            continue;
+        if (lookupIdentity(hashes[i], arr[i], arr) >= 0)
+            duplicates++;
+        identities.emplace(hashes[i], i);
+    }
+    built = true;
+    return duplicates;
+}
+
+void identityIndexInsert(int index, const Student &student)
+{
+    if (built)
+        identities.emplace(identityHash(student), index);
+}
+
+void identityIndexErase(int index, const Student &student)
+{
+    if (!built)
+        return;
+    auto range = identities.equal_range(identityHash(student));
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (it->second == index)
+        {
+            identities.erase(it);
+            return;
+        }
+    }
+}
+
+void identityIndexUpdate(int index, const Student &before, const Student &student)
+{
+    if (!built || sameIdentity(before, student))
+        return;
+    identityIndexErase(index, before);
+    identityIndexInsert(index, student);
+}
+
+// Position of a live record with the same identity as student, or -1.
+int findIdentity(const Student &student, const Student *arr, int count)
+{
+    if (!built)
+        buildIdentityIndex(arr, count);
+    return lookupIdentity(identityHash(student), student, arr);
+}
+
+size_t identityIndexBytes()
+{
+    return hashTableBytes(identities);
+}
+
+static vector<DuplicateProfile> collectProfiles(const Student *arr, int count)
+{
+    vector<uint64_t> hashes = identityHashes(arr, count);
+    vector<DuplicateProfile> profiles;
+    unordered_multimap<uint64_t, int> byHash;
+    for (int i = 0; i < count; i++)
+    {
+        if (arr[i].id == INVALID_STUDENT_ID)
+            continue;
+        int profile = -1;
+        auto range = byHash.equal_range(hashes[i]);
+        for (auto it = range.first; it != range.second && profile < 0; ++it)
+        {
+            if (sameIdentity(arr[profiles[it->second].members[0]], arr[i]))
+                profile = it->second;
+        }
+        if (profile < 0)
+        {
+            profile = profiles.size();
+            byHash.emplace(hashes[i], profile);
+            profiles.emplace_back();
+        }
+        profiles[profile].members.push_back(i);
+    }
+
+    parallelFor(0, profiles.size(), PARALLEL_FOR_GRAIN, [&](size_t from, size_t to) {
+        for (size_t p = from; p < to; p++)
+        {
+            const Student &student = arr[profiles[p].members[0]];
+            profiles[p].year = student.year;
+            profiles[p].surname = foldName(student.surname);
+            profiles[p].name = foldName(student.name);
+            profiles[p].middleName = foldName(student.middleName);
+        }
+    });
+    return profiles;
+}
+
+// Two blocking passes within a birth year, so a typo at the start of the
+// surname or of the name still leaves the pair in a shared block.
+static vector<vector<int>> blockProfiles(const vector<DuplicateProfile> &profiles)
+{
+    unordered_map<string, vector<int>> keyed;
+    for (int p = 0; p < (int)profiles.size(); p++)
+    {
+        const DuplicateProfile &profile = profiles[p];
+        string year = to_string(profile.year);
+        string surname = profile.surname.substr(0, BLOCK_PREFIX);
+        string name = profile.name.substr(0, BLOCK_PREFIX);
+        string middleName = profile.middleName.substr(0, BLOCK_PREFIX);
+        keyed["a" + year + "|" + surname].push_back(p);
+        keyed["b" + year + "|" + name + "|" + middleName].push_back(p);
+    }
+
+    vector<vector<int>> blocks;
+    for (auto &entry : keyed)
+    {
+        if (entry.second.size() > 1)
+            blocks.push_back(move(entry.second));
+    }
+    return blocks;
+}
+
+static int profileDistance(const DuplicateProfile &a, const DuplicateProfile &b)
+{
+    if (a.year != b.year)
+        return DUPLICATE_MAX_DISTANCE + 1;
+    int distance = 0;
+    const string *left[] = {&a.surname, &a.name, &a.middleName};
+    const string *right[] = {&b.surname, &b.name, &b.middleName};
+    for (int k = 0; k < 3 && distance <= DUPLICATE_MAX_DISTANCE; k++)
+        distance += boundedEditDistance(*left[k], *right[k], DUPLICATE_MAX_DISTANCE - distance);
+    return distance;
+}
+
+static int findRoot(vector<int> &parent, int p)
+{
+    while (parent[p] != p)
+    {
+        parent[p] = parent[parent[p]];
+        p = parent[p];
+    }
+    return p;
+}
+
+// Blocks are compared in parallel. Inside a block, profiles are sorted by
+// name and each is compared with the next DUPLICATE_WINDOW ones, so a huge
+// block of common names costs O(n * window) instead of O(n^2).
+vector<DuplicateGroup> findDuplicateGroups(const Student *arr, int count)
+{
+    vector<DuplicateProfile> profiles = collectProfiles(arr, count);
+    vector<vector<int>> blocks = blockProfiles(profiles);
+
+    mutex pairsLock;
+    vector<pair<int, int>> pairs;
+    parallelFor(0, blocks.size(), BLOCK_GRAIN, [&](size_t from, size_t to) {
+        vector<pair<int, int>> local;
+        for (size_t b = from; b < to; b++)
+        {
+            vector<int> &block = blocks[b];
+            sort(block.begin(), block.end(), [&](int x, int y) {
+                const DuplicateProfile &px = profiles[x];
+                const DuplicateProfile &py = profiles[y];
+                return tie(px.surname, px.name, px.middleName) < tie(py.surname, py.name, py.middleName);
+            });
+            for (size_t i = 0; i < block.size(); i++)
+            {
+                size_t last = min(block.size(), i + 1 + DUPLICATE_WINDOW);
+                for (size_t j = i + 1; j < last; j++)
+                {
+                    if (profileDistance(profiles[block[i]], profiles[block[j]]) <= DUPLICATE_MAX_DISTANCE)
+                        local.emplace_back(block[i], block[j]);
+                }
+            }
+        }
+        lock_guard<mutex> guard(pairsLock);
+        pairs.insert(pairs.end(), local.begin(), local.end());
+    });
+
+    vector<int> parent(profiles.size());
+    iota(parent.begin(), parent.end(), 0);
+    for (const auto &linked : pairs)
+        parent[findRoot(parent, linked.first)] = findRoot(parent, linked.second);
+
+    unordered_map<int, int> groupOfRoot;
+    vector<DuplicateGroup> groups;
+    for (int p = 0; p < (int)profiles.size(); p++)
+    {
+        int root = findRoot(parent, p);
+        auto found = groupOfRoot.emplace(root, groups.size());
+        if (found.second)
+            groups.emplace_back();
+        DuplicateGroup &group = groups[found.first->second];
+        group.members.insert(group.members.end(), profiles[p].members.begin(), profiles[p].members.end());
+        if (profiles[p].members.size() > 1)
+            group.exactSets.push_back(profiles[p].members);
+    }
+
+    vector<DuplicateGroup> duplicates;
+    for (DuplicateGroup &group : groups)
+    {
+        if (group.members.size() < 2)
+            continue;
+        sort(group.members.begin(), group.members.end());
+        duplicates.push_back(move(group));
+    }
+    sort(duplicates.begin(), duplicates.end(),
+         [](const DuplicateGroup &a, const DuplicateGroup &b) { return a.members[0] < b.members[0]; });
+    return duplicates;
+}
+
+// The first member keeps its grades; subjects it lacks are taken from the
+// others in order while there is room.
+SubjectList mergedSubjects(const Student *arr, const vector<int> &members)
+{
+    SubjectListBuilder builder;
+    vector<string_view> taken;
+    for (int index : members)
+    {
+        const SubjectList &subjects = arr[index].subjects;
+        for (int j = 0; j < subjects.size() && builder.size() < MAX_SUBJECTS; j++)
+        {
+            string_view subject = subjects.subject(j);
+            if (find(taken.begin(), taken.end(), subject) != taken.end())
+                continue;
+            taken.push_back(subject);
+            builder.add(subject, subjects.grades(j));
+        }
+    }
+    return builder.build();
+}
@@ -0,0 +1,39 @@
+#ifndef UTP_DUPLICATES_H
+#define UTP_DUPLICATES_H
+
+#include <vector>
+#include "Student.h"
+
+const int DUPLICATE_MAX_DISTANCE = 2;
+const int DUPLICATE_WINDOW = 64;
+
+// A student's identity is the case-folded surname, name and middle name plus
+// the birth year; two live records with the same identity are exact duplicates.
+bool sameIdentity(const Student &a, const Student &b);
+
+// Hash set of identities over roster positions, so adding a student can be
+// checked in O(1). Positions only move on reload or reorder, which reset it.
+void resetIdentityIndex();
+int buildIdentityIndex(const Student *arr, int count);
+void identityIndexInsert(int index, const Student &student);
+void identityIndexUpdate(int index, const Student &before, const Student &student);
+void identityIndexErase(int index, const Student &student);
+int findIdentity(const Student &student, const Student *arr, int count);
+size_t identityIndexBytes();
+
+// Positions of one cluster of duplicates; exactSets lists its subsets that
+// share an identity, so exact duplicates can be merged on their own.
+struct DuplicateGroup
+{
+    std::vector<int> members;
+    std::vector<std::vector<int>> exactSets;
+
+    bool exact() const { return exactSets.size() == 1 && exactSets[0].size() == members.size(); }
+};
+
+// Offline sweep: exact duplicates plus near-duplicates born the same year
+// whose transliterated names differ by at most DUPLICATE_MAX_DISTANCE edits.
+std::vector<DuplicateGroup> findDuplicateGroups(const Student *arr, int count);
+SubjectList mergedSubjects(const Student *arr, const std::vector<int> &members);
+
+#endif
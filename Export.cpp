@@ -0,0 +1,386 @@
+#include "Export.h"
+#include "DisplayWidth.h"
+
+#include <charconv>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+static void bufFlush(ExportBuffer &buf)
+{
+    if (buf.used == 0)
+        return;
+    fwrite(buf.data.data(), 1, buf.used, buf.out);
+    buf.written += buf.used;
+    buf.used = 0;
+}
+
+static char *bufReserve(ExportBuffer &buf, size_t n)
+{
+    if (buf.used + n > buf.data.size())
+    {
+        bufFlush(buf);
+        if (n > buf.data.size())
+            buf.data.resize(n);
+    }
+    return buf.data.data() + buf.used;
+}
+
+static void bufAppend(ExportBuffer &buf, const char *s, size_t n)
+{
+    memcpy(bufReserve(buf, n), s, n);
+    buf.used += n;
+}
+
+static void bufAppend(ExportBuffer &buf, string_view s)
+{
+    bufAppend(buf, s.data(), s.size());
+}
+
+static void bufAppend(ExportBuffer &buf, const char *s)
+{
+    bufAppend(buf, s, strlen(s));
+}
+
+static void bufPut(ExportBuffer &buf, char c)
+{
+    *bufReserve(buf, 1) = c;
+    buf.used++;
+}
+
+static void bufInt(ExportBuffer &buf, int value)
+{
+    char *p = bufReserve(buf, 16);
+    buf.used += to_chars(p, p + 16, value).ptr - p;
+}
+
+// Visits the pieces describeSubjects() joins, so the writers format the list
+// straight into the buffer instead of building it per record; stops early when
+// visit returns false.
+template <typename Visit>
+static void forEachSubjectPiece(const SubjectList &subjects, Visit visit)
+{
+    for (int j = 0; j < subjects.size(); j++)
+    {
+        if ((j != 0 && !visit(string_view("; ", 2))) || !visit(subjects.subject(j)) ||
+            !visit(string_view(": ", 2)) || !visit(subjects.gradesText(j)))
+            return;
+    }
+}
+
+static bool csvNeedsQuotes(string_view s)
+{
+    for (char c : s)
+    {
+        if (c == ',' || c == '"' || c == '\r' || c == '\n')
+            return true;
+    }
+    return false;
+}
+
+// Each quote ends one run and starts the next, so it is written twice.
+static void csvEscaped(ExportBuffer &buf, string_view s)
+{
+    size_t start = 0;
+    for (size_t quote = s.find('"'); quote != string_view::npos; quote = s.find('"', quote + 1))
+    {
+        bufAppend(buf, s.data() + start, quote + 1 - start);
+        start = quote;
+    }
+    bufAppend(buf, s.data() + start, s.size() - start);
+}
+
+static void csvField(ExportBuffer &buf, string_view s)
+{
+    if (!csvNeedsQuotes(s))
+    {
+        bufAppend(buf, s);
+        return;
+    }
+    bufPut(buf, '"');
+    csvEscaped(buf, s);
+    bufPut(buf, '"');
+}
+
+static void csvSubjects(ExportBuffer &buf, const SubjectList &subjects)
+{
+    bool quote = false;
+    forEachSubjectPiece(subjects, [&](string_view piece) {
+        quote = csvNeedsQuotes(piece);
+        return !quote;
+    });
+    if (!quote)
+    {
+        forEachSubjectPiece(subjects, [&](string_view piece) {
+            bufAppend(buf, piece);
+            return true;
+        });
+        return;
+    }
+    bufPut(buf, '"');
+    forEachSubjectPiece(subjects, [&](string_view piece) {
+        csvEscaped(buf, piece);
+        return true;
+    });
+    bufPut(buf, '"');
+}
+
+static void csvHeader(ExportBuffer &buf)
+{
+    bufAppend(buf, "year,course,name,surname,middleName,subjects\r\n");
+}
+
+static void csvRecord(ExportBuffer &buf, const Student &student)
+{
+    bufInt(buf, student.year);
+    bufPut(buf, ',');
+    bufInt(buf, student.course);
+    bufPut(buf, ',');
+    csvField(buf, student.name);
+    bufPut(buf, ',');
+    csvField(buf, student.surname);
+    bufPut(buf, ',');
+    csvField(buf, student.middleName);
+    bufPut(buf, ',');
+    csvSubjects(buf, student.subjects);
+    bufAppend(buf, "\r\n", 2);
+}
+
+static void jsonString(ExportBuffer &buf, string_view s)
+{
+    static const char HEX[] = "0123456789abcdef";
+    bufPut(buf, '"');
+    size_t start = 0;
+    for (size_t i = 0; i < s.size(); i++)
+    {
+        unsigned char c = s[i];
+        if (c >= 0x20 && c != '"' && c != '\\')
+            continue;
+        bufAppend(buf, s.data() + start, i - start);
+        start = i + 1;
+        switch (c)
+        {
+        case '"':
+            bufAppend(buf, "\\\"", 2);
+            break;
+        case '\\':
+            bufAppend(buf, "\\\\", 2);
+            break;
+        case '\n':
+            bufAppend(buf, "\\n", 2);
+            break;
+        case '\r':
+            bufAppend(buf, "\\r", 2);
+            break;
+        case '\t':
+            bufAppend(buf, "\\t", 2);
+            break;
+        default:
+        {
+            char esc[6] = {'\\', 'u', '0', '0', HEX[c >> 4], HEX[c & 15]};
+            bufAppend(buf, esc, 6);
+        }
+        }
+    }
+    bufAppend(buf, s.data() + start, s.size() - start);
+    bufPut(buf, '"');
+}
+
+static void jsonlRecord(ExportBuffer &buf, const Student &student)
+{
+    bufAppend(buf, "{\"year\":");
+    bufInt(buf, student.year);
+    bufAppend(buf, ",\"course\":");
+    bufInt(buf, student.course);
+    bufAppend(buf, ",\"name\":");
+    jsonString(buf, student.name);
+    bufAppend(buf, ",\"surname\":");
+    jsonString(buf, student.surname);
+    bufAppend(buf, ",\"middleName\":");
+    jsonString(buf, student.middleName);
+    bufAppend(buf, ",\"subjects\":[");
+    for (int j = 0; j < student.subjects.size(); j++)
+    {
+        if (j != 0)
+            bufPut(buf, ',');
+        bufAppend(buf, "{\"name\":");
+        jsonString(buf, student.subjects.subject(j));
+        bufAppend(buf, ",\"grades\":[");
+        bufAppend(buf, student.subjects.gradesText(j));
+        bufAppend(buf, "]}", 2);
+    }
+    bufAppend(buf, "]}\n", 3);
+}
+
+static void markdownText(ExportBuffer &buf, string_view s)
+{
+    size_t start = 0;
+    for (size_t i = 0; i < s.size(); i++)
+    {
+        if (s[i] != '|' && s[i] != '\\' && s[i] != '\n' && s[i] != '\r')
+            continue;
+        bufAppend(buf, s.data() + start, i - start);
+        start = i + 1;
+        if (s[i] == '\n' || s[i] == '\r')
+            bufPut(buf, ' ');
+        else
+        {
+            bufPut(buf, '\\');
+            bufPut(buf, s[i]);
+        }
+    }
+    bufAppend(buf, s.data() + start, s.size() - start);
+}
+
+static void markdownCell(ExportBuffer &buf, string_view s)
+{
+    bufAppend(buf, " ", 1);
+    markdownText(buf, s);
+    bufAppend(buf, " |", 2);
+}
+
+static void markdownSubjects(ExportBuffer &buf, const SubjectList &subjects)
+{
+    bufAppend(buf, " ", 1);
+    forEachSubjectPiece(subjects, [&](string_view piece) {
+        markdownText(buf, piece);
+        return true;
+    });
+    bufAppend(buf, " |", 2);
+}
+
+static void markdownHeader(ExportBuffer &buf)
+{
+    bufAppend(buf, "| Год | Курс | Имя | Фамилия | Отчество | Предметы и оценки |\n");
+    bufAppend(buf, "|---:|---:|---|---|---|---|\n");
+}
+
+static void markdownRecord(ExportBuffer &buf, const Student &student)
+{
+    bufAppend(buf, "| ", 2);
+    bufInt(buf, student.year);
+    bufAppend(buf, " | ", 3);
+    bufInt(buf, student.course);
+    bufAppend(buf, " |", 2);
+    markdownCell(buf, student.name);
+    markdownCell(buf, student.surname);
+    markdownCell(buf, student.middleName);
+    markdownSubjects(buf, student.subjects);
+    bufPut(buf, '\n');
+}
+
+const int FIXED_COLUMNS = 6;
+const int FIXED_WIDTHS[FIXED_COLUMNS] = {4, 5, 20, 24, 24, 60};
+
+static void fixedCell(ExportBuffer &buf, string_view s, int width)
+{
+    int columns;
+    size_t end = widthPrefix(s, width, columns);
+    bufAppend(buf, s.data(), end);
+    memset(bufReserve(buf, width - columns + 1), ' ', width - columns + 1);
+    buf.used += width - columns + 1;
+}
+
+// Same cut as fixedCell() on the joined text: the piece that overflows is cut
+// at the last whole character that fits and the rest are skipped.
+static void fixedSubjects(ExportBuffer &buf, const SubjectList &subjects, int width)
+{
+    int columns = 0;
+    forEachSubjectPiece(subjects, [&](string_view piece) {
+        int used;
+        size_t end = widthPrefix(piece, width - columns, used);
+        bufAppend(buf, piece.data(), end);
+        columns += used;
+        return end == piece.size();
+    });
+    memset(bufReserve(buf, width - columns + 1), ' ', width - columns + 1);
+    buf.used += width - columns + 1;
+}
+
+static void fixedHeader(ExportBuffer &buf)
+{
+    const char *titles[FIXED_COLUMNS] = {"Год", "Курс", "Имя", "Фамилия", "Отчество", "Предметы и оценки"};
+    for (int j = 0; j < FIXED_COLUMNS; j++)
+        fixedCell(buf, titles[j], FIXED_WIDTHS[j]);
+    bufPut(buf, '\n');
+}
+
+static void fixedRecord(ExportBuffer &buf, const Student &student)
+{
+    char number[16];
+    fixedCell(buf, string_view(number, to_chars(number, number + 16, student.year).ptr - number), FIXED_WIDTHS[0]);
+    fixedCell(buf, string_view(number, to_chars(number, number + 16, student.course).ptr - number), FIXED_WIDTHS[1]);
+    fixedCell(buf, student.name, FIXED_WIDTHS[2]);
+    fixedCell(buf, student.surname, FIXED_WIDTHS[3]);
+    fixedCell(buf, student.middleName, FIXED_WIDTHS[4]);
+    fixedSubjects(buf, student.subjects, FIXED_WIDTHS[5]);
+    bufPut(buf, '\n');
+}
+
+static void noFooter(ExportBuffer &)
+{
+}
+
+static void noHeader(ExportBuffer &)
+{
+}
+
+const vector<ExportFormat> &exportFormats()
+{
+    static const vector<ExportFormat> formats = {
+        {"csv", "CSV (RFC 4180)", csvHeader, csvRecord, noFooter},
+        {"jsonl", "JSON Lines", noHeader, jsonlRecord, noFooter},
+        {"md", "Markdown-таблица", markdownHeader, markdownRecord, noFooter},
+        {"fixed", "Фиксированная ширина колонок", fixedHeader, fixedRecord, noFooter},
+    };
+    return formats;
+}
+
+const ExportFormat *findExportFormat(const string &name)
+{
+    for (const auto &format : exportFormats())
+    {
+        if (name == format.name)
+            return &format;
+    }
+    return nullptr;
+}
+
+bool exportStudents(const ExportFormat &format, const string &path, int count, const Student &(*at)(int),
+                    ostream &report)
+{
+    bool toStdout = path == "-";
+    FILE *out = toStdout ? stdout : fopen(path.c_str(), "wb");
+    if (!out)
+    {
+        report << "Ошибка: не удалось открыть файл " << path << " для записи.\n";
+        return false;
+    }
+
+    ExportBuffer buf;
+    buf.data.resize(EXPORT_BUFFER_SIZE);
+    buf.used = 0;
+    buf.out = out;
+    buf.written = 0;
+
+    format.header(buf);
+    for (int i = 0; i < count; i++)
+        format.record(buf, at(i));
+    format.footer(buf);
+    bufFlush(buf);
+
+    bool ok = !ferror(out);
+    if (toStdout)
+        fflush(out);
+    else
+        ok = fclose(out) == 0 && ok;
+
+    if (!ok)
+    {
+        report << "Ошибка записи при экспорте.\n";
+        return false;
+    }
+    (toStdout ? cerr : report) << "Экспортировано записей: " << count << " (" << buf.written << " байт).\n";
+    return true;
+}
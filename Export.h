@@ -0,0 +1,36 @@
+#ifndef UTP_EXPORT_H
+#define UTP_EXPORT_H
+
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Student.h"
+
+struct ExportBuffer
+{
+    std::vector<char> data;
+    size_t used;
+    FILE *out;
+    long long written;
+};
+
+struct ExportFormat
+{
+    const char *name;
+    const char *description;
+    void (*header)(ExportBuffer &buf);
+    void (*record)(ExportBuffer &buf, const Student &student);
+    void (*footer)(ExportBuffer &buf);
+};
+
+const size_t EXPORT_BUFFER_SIZE = 1 << 20;
+
+const std::vector<ExportFormat> &exportFormats();
+const ExportFormat *findExportFormat(const std::string &name);
+// Messages go to report; a background export passes a buffer and prints it
+// once done.
+bool exportStudents(const ExportFormat &format, const std::string &path, int count, const Student &(*at)(int),
+                    std::ostream &report = std::cout);
+
+#endif
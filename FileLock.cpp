@@ -0,0 +1,78 @@
+#include "FileLock.h"
+
+#include <cerrno>
+#include <unordered_map>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+const intptr_t NO_LOCK_HANDLE = -1;
+
+// Nesting is per thread: the roster watcher reads files while the menu may hold locks.
+static thread_local unordered_map<string, int> heldLocks;
+
+static intptr_t acquire(const string &lockPath, FileLockMode mode)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(lockPath.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                              nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return NO_LOCK_HANDLE;
+    OVERLAPPED range = {};
+    DWORD flags = mode == FILE_LOCK_EXCLUSIVE ? LOCKFILE_EXCLUSIVE_LOCK : 0;
+    if (!LockFileEx(file, flags, 0, MAXDWORD, MAXDWORD, &range))
+    {
+        CloseHandle(file);
+        return NO_LOCK_HANDLE;
+    }
+    return (intptr_t)file;
+#else
+    int fd = open(lockPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return NO_LOCK_HANDLE;
+    while (flock(fd, mode == FILE_LOCK_EXCLUSIVE ? LOCK_EX : LOCK_SH) != 0)
+    {
+        if (errno != EINTR)
+        {
+            close(fd);
+            return NO_LOCK_HANDLE;
+        }
+    }
+    return fd;
+#endif
+}
+
+static void release(intptr_t handle)
+{
+#ifdef _WIN32
+    OVERLAPPED range = {};
+    UnlockFileEx((HANDLE)handle, 0, MAXDWORD, MAXDWORD, &range);
+    CloseHandle((HANDLE)handle);
+#else
+    flock((int)handle, LOCK_UN);
+    close((int)handle);
+#endif
+}
+
+FileLock::FileLock(const string &dataPath, FileLockMode mode)
+    : path(dataPath + ".lock"), handle(NO_LOCK_HANDLE)
+{
+    int &depth = heldLocks[path];
+    if (depth++ == 0)
+        handle = acquire(path, mode);
+}
+
+FileLock::~FileLock()
+{
+    if (handle != NO_LOCK_HANDLE)
+        release(handle);
+    if (--heldLocks[path] == 0)
+        heldLocks.erase(path);
+}
@@ -0,0 +1,25 @@
+#ifndef UTP_FILELOCK_H
+#define UTP_FILELOCK_H
+
+#include <cstdint>
+#include <string>
+
+enum FileLockMode
+{
+    FILE_LOCK_SHARED,
+    FILE_LOCK_EXCLUSIVE
+};
+
+struct FileLock
+{
+    std::string path;
+    std::intptr_t handle;
+
+    FileLock(const std::string &dataPath, FileLockMode mode);
+    ~FileLock();
+
+    FileLock(const FileLock &) = delete;
+    FileLock &operator=(const FileLock &) = delete;
+};
+
+#endif
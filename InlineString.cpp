@@ -0,0 +1,85 @@
+#include "InlineString.h"
+
+using namespace std;
+
+static size_t overflowCount = 0;
+static size_t heapBytes = 0;
+
+InlineName::InlineName(const InlineName &other)
+{
+    buf[CAPACITY] = 0;
+    *this = string_view(other);
+}
+
+InlineName::InlineName(InlineName &&other) noexcept
+{
+    memcpy(buf, other.buf, sizeof(buf));
+    other.buf[CAPACITY] = 0;
+}
+
+InlineName &InlineName::operator=(InlineName &&other) noexcept
+{
+    if (this != &other)
+    {
+        release();
+        memcpy(buf, other.buf, sizeof(buf));
+        other.buf[CAPACITY] = 0;
+    }
+    return *this;
+}
+
+InlineName &InlineName::operator=(const InlineName &other)
+{
+    if (this != &other)
+        *this = string_view(other);
+    return *this;
+}
+
+InlineName &InlineName::operator=(string_view s)
+{
+    if (s.size() <= CAPACITY)
+    {
+        char copy[CAPACITY];
+        memcpy(copy, s.data(), s.size());
+        release();
+        memcpy(buf, copy, s.size());
+        buf[CAPACITY] = (char)s.size();
+        return *this;
+    }
+
+    char *ptr = new char[s.size()];
+    memcpy(ptr, s.data(), s.size());
+    size_t size = s.size();
+    release();
+    memcpy(buf, &ptr, sizeof(ptr));
+    memcpy(buf + sizeof(ptr), &size, sizeof(size));
+    buf[CAPACITY] = (char)HEAP_TAG;
+    overflowCount++;
+    heapBytes += size;
+    return *this;
+}
+
+InlineName::~InlineName()
+{
+    release();
+}
+
+void InlineName::release()
+{
+    if (onHeap())
+    {
+        heapBytes -= heapSize();
+        delete[] heapPtr();
+    }
+    buf[CAPACITY] = 0;
+}
+
+size_t inlineNameOverflows()
+{
+    return overflowCount;
+}
+
+size_t inlineNameHeapBytes()
+{
+    return heapBytes;
+}
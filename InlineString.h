@@ -0,0 +1,65 @@
+#ifndef UTP_INLINESTRING_H
+#define UTP_INLINESTRING_H
+
+#include <cstddef>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+const size_t INLINE_NAME_BYTES = 48;
+
+class InlineName
+{
+public:
+    static const size_t CAPACITY = INLINE_NAME_BYTES - 1;
+
+    InlineName() { buf[CAPACITY] = 0; }
+    InlineName(const InlineName &other);
+    InlineName(InlineName &&other) noexcept;
+    InlineName &operator=(const InlineName &other);
+    InlineName &operator=(InlineName &&other) noexcept;
+    InlineName &operator=(std::string_view s);
+    ~InlineName();
+
+    const char *data() const { return onHeap() ? heapPtr() : buf; }
+    size_t size() const { return onHeap() ? heapSize() : tag(); }
+    size_t length() const { return size(); }
+    bool empty() const { return size() == 0; }
+    bool onHeap() const { return tag() == HEAP_TAG; }
+    char operator[](size_t i) const { return data()[i]; }
+    std::string str() const { return std::string(data(), size()); }
+    operator std::string_view() const { return std::string_view(data(), size()); }
+
+private:
+    static const unsigned char HEAP_TAG = 0xFF;
+
+    unsigned char tag() const { return (unsigned char)buf[CAPACITY]; }
+    char *heapPtr() const
+    {
+        char *ptr;
+        std::memcpy(&ptr, buf, sizeof(ptr));
+        return ptr;
+    }
+    size_t heapSize() const
+    {
+        size_t size;
+        std::memcpy(&size, buf + sizeof(char *), sizeof(size));
+        return size;
+    }
+    void release();
+
+    alignas(char *) char buf[INLINE_NAME_BYTES];
+};
+
+static_assert(sizeof(InlineName) == INLINE_NAME_BYTES, "InlineName must stay one cache-friendly block");
+
+inline std::ostream &operator<<(std::ostream &out, const InlineName &s)
+{
+    return out.write(s.data(), s.size());
+}
+
+size_t inlineNameOverflows();
+size_t inlineNameHeapBytes();
+
+#endif
@@ -0,0 +1,673 @@
+#include "LazyStore.h"
+#include "Memory.h"
+#include "BinaryStore.h"
+#include "RosterMerge.h"
+#include "Snapshot.h"
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <list>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+bool parseTextFields(string_view line, Student &student, SubjectListBuilder &builder);
+bool decodeBinaryFields(const char *&p, const char *end, Student &student, SubjectListBuilder &builder);
+bool textFileFormatSupported(const string &path);
+RosterVersion observeRoster(const string &path, bool binary);
+void writeTextStudent(ostream &out, const Student &student);
+bool writeBinaryStudent(ostream &out, const Student &student);
+
+struct LazyIndexHeader
+{
+    char magic[8];
+    int32_t binary;
+    int32_t reserved;
+    int64_t sourceSize;
+    int64_t sourceTime;
+    int64_t count;
+};
+
+const char LAZY_INDEX_MAGIC[8] = {'U', 'T', 'P', 'I', 'D', 'X', '1', '\0'};
+const size_t LAZY_IO_CHUNK = 1 << 20;
+const int64_t LAZY_OFFSET_BLOCK = 4096;
+
+static bool lazyOpen = false;
+static bool lazyBinary = false;
+static bool lazySlots = false;
+static bool lazySnapshot = false;
+static string lazyPath;
+static int64_t lazyCount = 0;
+static RosterVersion lazyVersion;
+static ifstream lazyData;
+static ifstream lazyIndex;
+
+struct LazyEntry
+{
+    int index;
+    Student student;
+    vector<char> bytes;
+};
+
+static list<LazyEntry> lazyLru;
+static unordered_map<int, list<LazyEntry>::iterator> lazyLruPos;
+static map<int, Student> lazyDirty;
+
+static vector<uint64_t> lazyOffsetBlock;
+static int64_t lazyOffsetBlockFirst = -1;
+static string lazyWindow;
+static uint64_t lazyWindowStart = 0;
+
+static string indexPathFor(const string &path)
+{
+    return path + ".idx";
+}
+
+static int64_t sourceTimeOf(const string &path)
+{
+    error_code ec;
+    auto t = filesystem::last_write_time(path, ec);
+    if (ec)
+        return 0;
+    return (int64_t)t.time_since_epoch().count();
+}
+
+static bool readIndexHeader(ifstream &idx, LazyIndexHeader &header)
+{
+    idx.seekg(0);
+    idx.read((char *)&header, sizeof(header));
+    return (bool)idx && memcmp(header.magic, LAZY_INDEX_MAGIC, sizeof(header.magic)) == 0;
+}
+
+static void writeIndexHeader(ostream &out, const string &path, bool binary, int64_t count)
+{
+    LazyIndexHeader header;
+    memcpy(header.magic, LAZY_INDEX_MAGIC, sizeof(header.magic));
+    header.binary = binary ? 1 : 0;
+    header.reserved = 0;
+    header.sourceSize = (int64_t)filesystem::file_size(path);
+    header.sourceTime = sourceTimeOf(path);
+    header.count = count;
+    out.seekp(0);
+    out.write((char *)&header, sizeof(header));
+}
+
+static bool buildTextIndex(const string &path, ofstream &idx, int64_t &count)
+{
+    ifstream fin(path, ios::binary);
+    if (!fin)
+        return false;
+
+    vector<char> buffer(LAZY_IO_CHUNK);
+    uint64_t lineStart = 0;
+    uint64_t pos = 0;
+    int delimiters = 0;
+    count = 0;
+
+    auto finishLine = [&](uint64_t lineEnd) {
+        if (lineEnd > lineStart && delimiters >= 4 && delimiters % 2 == 0)
+        {
+            idx.write((char *)&lineStart, sizeof(lineStart));
+            count++;
+        }
+        delimiters = 0;
+    };
+
+    while (fin)
+    {
+        fin.read(buffer.data(), buffer.size());
+        streamsize got = fin.gcount();
+        for (streamsize i = 0; i < got; i++, pos++)
+        {
+            char c = buffer[i];
+            if (c == '|')
+            {
+                delimiters++;
+            }
+            else if (c == '\n')
+            {
+                finishLine(pos);
+                lineStart = pos + 1;
+            }
+        }
+    }
+    finishLine(pos);
+    idx.write((char *)&pos, sizeof(pos));
+    return true;
+}
+
+static bool buildSlotIndex(ifstream &fin, const BinaryStoreHeader &header, ofstream &idx, int64_t &count)
+{
+    count = 0;
+    BinaryStoreSlot slot;
+    for (int64_t i = 0; i < header.slotCount; i++)
+    {
+        if (!fin.read((char *)&slot, sizeof(slot)))
+        {
+            cout << "Ошибка: бинарный файл повреждён, слот " << i + 1 << ".\n";
+            return false;
+        }
+        if (!slot.live)
+            continue;
+        uint64_t slotStart = binarySlotOffset(i);
+        idx.write((char *)&slotStart, sizeof(slotStart));
+        count++;
+    }
+    uint64_t end = binarySlotOffset(header.slotCount);
+    idx.write((char *)&end, sizeof(end));
+    return true;
+}
+
+static bool buildBinaryIndex(const string &path, ofstream &idx, int64_t &count)
+{
+    ifstream fin(path, ios::binary);
+    if (!fin)
+        return false;
+
+    BinaryStoreHeader header;
+    if (readBinaryStoreHeader(fin, header))
+        return buildSlotIndex(fin, header, idx, count);
+
+    uint64_t fileSize = filesystem::file_size(path);
+    vector<char> buffer(LAZY_IO_CHUNK);
+    uint64_t bufStart = 0;
+    uint64_t bufLen = 0;
+
+    auto readInt = [&](uint64_t at, int &value) {
+        if (at < bufStart || at + sizeof(int) > bufStart + bufLen)
+        {
+            fin.clear();
+            fin.seekg(at);
+            fin.read(buffer.data(), buffer.size());
+            bufStart = at;
+            bufLen = fin.gcount();
+            if (bufLen < sizeof(int))
+                return false;
+        }
+        memcpy(&value, buffer.data() + (at - bufStart), sizeof(int));
+        return true;
+    };
+
+    int countFromFile = 0;
+    if (!readInt(0, countFromFile) || countFromFile < 0)
+        return false;
+
+    uint64_t pos = sizeof(int);
+    count = 0;
+    for (int i = 0; i < countFromFile; i++)
+    {
+        uint64_t recordStart = pos;
+        pos += 2 * sizeof(int);
+        for (int field = 0; field < 9; field++)
+        {
+            int len = 0;
+            if (!readInt(pos, len) || len < 0 || pos + sizeof(int) + len > fileSize)
+            {
+                cout << "Ошибка: бинарный файл повреждён, запись " << i + 1 << ".\n";
+                return false;
+            }
+            pos += sizeof(int) + len;
+        }
+        idx.write((char *)&recordStart, sizeof(recordStart));
+        count++;
+    }
+    idx.write((char *)&pos, sizeof(pos));
+    return true;
+}
+
+static bool isOlderSlotStore(const string &path)
+{
+    ifstream in(path, ios::binary);
+    char header[sizeof(BinaryStoreHeader)];
+    if (!in.read(header, sizeof(header)))
+        return false;
+    int version = binaryStoreVersion(header, sizeof(header));
+    return version != 0 && version != BINARY_STORE_VERSION;
+}
+
+static bool indexIsFresh(const string &path, bool binary)
+{
+    ifstream idx(indexPathFor(path), ios::binary);
+    LazyIndexHeader header;
+    if (!idx || !readIndexHeader(idx, header))
+        return false;
+    error_code ec;
+    int64_t size = (int64_t)filesystem::file_size(path, ec);
+    return !ec && header.binary == (binary ? 1 : 0) && header.sourceSize == size && header.sourceTime == sourceTimeOf(path);
+}
+
+static bool buildIndex(const string &path, bool binary)
+{
+    string idxPath = indexPathFor(path);
+    ofstream idx(idxPath, ios::binary | ios::trunc);
+    if (!idx)
+        return false;
+
+    LazyIndexHeader placeholder = {};
+    idx.write((char *)&placeholder, sizeof(placeholder));
+
+    int64_t count = 0;
+    bool ok = binary ? buildBinaryIndex(path, idx, count) : buildTextIndex(path, idx, count);
+    if (!ok)
+    {
+        idx.close();
+        filesystem::remove(idxPath);
+        return false;
+    }
+    writeIndexHeader(idx, path, binary, count);
+    idx.close();
+    cout << "Индекс построен: " << count << " записей.\n";
+    return true;
+}
+
+static bool readOffsets(int64_t first, int64_t n, vector<uint64_t> &offsets)
+{
+    offsets.resize(n);
+    lazyIndex.clear();
+    lazyIndex.seekg(sizeof(LazyIndexHeader) + first * sizeof(uint64_t));
+    lazyIndex.read((char *)offsets.data(), n * sizeof(uint64_t));
+    return (bool)lazyIndex;
+}
+
+bool openLazyStore(const string &path, bool binary)
+{
+    closeLazyStore();
+    if (!filesystem::exists(path))
+    {
+        cout << "Ошибка: файл " << path << " не найден.\n";
+        return false;
+    }
+    if (binary && isOlderSlotStore(path))
+    {
+        cout << "Ошибка: бинарный файл в формате предыдущей версии. Загрузите его полностью и сохраните.\n";
+        return false;
+    }
+    if (!binary && !textFileFormatSupported(path))
+    {
+        cout << "Ошибка: текстовый файл записан в неизвестной версии формата.\n";
+        return false;
+    }
+    if (!indexIsFresh(path, binary) && !buildIndex(path, binary))
+    {
+        cout << "Ошибка: не удалось построить индекс записей.\n";
+        return false;
+    }
+
+    lazyIndex.open(indexPathFor(path), ios::binary);
+    lazyData.open(path, ios::binary);
+    LazyIndexHeader header;
+    if (!lazyIndex || !lazyData || !readIndexHeader(lazyIndex, header))
+    {
+        lazyIndex.close();
+        lazyData.close();
+        cout << "Ошибка: не удалось открыть индекс записей.\n";
+        return false;
+    }
+
+    BinaryStoreHeader slotHeader;
+    lazyPath = path;
+    lazyBinary = binary;
+    lazySlots = binary && readBinaryStoreHeader(lazyData, slotHeader);
+    lazyCount = header.count;
+    lazyVersion = observeRoster(path, binary);
+    lazyOpen = true;
+    return true;
+}
+
+void closeLazyStore()
+{
+    if (!lazyOpen)
+        return;
+    lazyData.close();
+    lazyIndex.close();
+    lazyLru.clear();
+    lazyLruPos.clear();
+    lazyDirty.clear();
+    lazyOffsetBlock.clear();
+    lazyOffsetBlockFirst = -1;
+    lazyWindow.clear();
+    lazyWindowStart = 0;
+    lazyCount = 0;
+    lazySlots = false;
+    lazySnapshot = false;
+    lazyOpen = false;
+}
+
+bool openLazySnapshot(const SnapshotSource &source, int count)
+{
+    closeLazyStore();
+    lazyPath = source.path;
+    lazyBinary = source.binary;
+    lazyCount = count;
+    lazySnapshot = true;
+    lazyOpen = true;
+    return true;
+}
+
+bool lazyStoreSnapshot()
+{
+    return lazySnapshot;
+}
+
+bool lazyStoreActive()
+{
+    return lazyOpen;
+}
+
+bool lazyStoreBinary()
+{
+    return lazyBinary;
+}
+
+int lazyRecordCount()
+{
+    return (int)lazyCount;
+}
+
+static bool recordSpan(int64_t index, uint64_t &begin, uint64_t &end)
+{
+    if (index < lazyOffsetBlockFirst || index + 1 >= lazyOffsetBlockFirst + (int64_t)lazyOffsetBlock.size())
+    {
+        int64_t n = min<int64_t>(LAZY_OFFSET_BLOCK, lazyCount - index) + 1;
+        lazyOffsetBlockFirst = -1;
+        if (!readOffsets(index, n, lazyOffsetBlock))
+            return false;
+        lazyOffsetBlockFirst = index;
+    }
+    begin = lazyOffsetBlock[index - lazyOffsetBlockFirst];
+    end = lazyOffsetBlock[index + 1 - lazyOffsetBlockFirst];
+    return true;
+}
+
+static const char *windowFor(uint64_t begin, uint64_t end)
+{
+    if (begin < lazyWindowStart || end > lazyWindowStart + lazyWindow.size())
+    {
+        lazyWindow.resize(max<uint64_t>(LAZY_IO_CHUNK, end - begin));
+        lazyData.clear();
+        lazyData.seekg(begin);
+        lazyData.read(&lazyWindow[0], lazyWindow.size());
+        lazyWindow.resize(lazyData.gcount());
+        lazyWindowStart = begin;
+        if (end > lazyWindowStart + lazyWindow.size())
+            return nullptr;
+    }
+    return lazyWindow.data() + (begin - lazyWindowStart);
+}
+
+static void decodeSlotRecord(LazyEntry &entry, uint64_t slotStart)
+{
+    BinaryStoreSlot slot;
+    lazyData.clear();
+    lazyData.seekg(slotStart);
+    if (!lazyData.read((char *)&slot, sizeof(slot)))
+        return;
+    entry.bytes.resize(binarySlotBlockLength(slot));
+    lazyData.seekg(slot.offset);
+    if (!lazyData.read(entry.bytes.data(), entry.bytes.size()))
+        return;
+    decodeBinarySlot(slot, entry.bytes.data(), entry.student);
+}
+
+static void decodeRecord(LazyEntry &entry)
+{
+    if (lazySnapshot)
+    {
+        readSnapshotRecord(entry.index, entry.student);
+        return;
+    }
+    uint64_t begin = 0;
+    uint64_t end = 0;
+    if (!recordSpan(entry.index, begin, end))
+        return;
+    if (lazySlots)
+    {
+        decodeSlotRecord(entry, begin);
+        return;
+    }
+    const char *p = windowFor(begin, end);
+    if (!p)
+        return;
+    const char *last = p + (end - begin);
+
+    // The subject block goes into entry.bytes instead of the edit arena, so evicting the entry frees it.
+    static SubjectListBuilder builder;
+    builder.clear();
+    bool parsed;
+    if (!lazyBinary)
+    {
+        const char *newline = (const char *)memchr(p, '\n', last - p);
+        parsed = parseTextFields(string_view(p, (newline ? newline : last) - p), entry.student, builder);
+    }
+    else
+        parsed = decodeBinaryFields(p, last, entry.student, builder);
+    if (!parsed)
+        return;
+    string_view encoded = builder.encode();
+    entry.bytes.assign(encoded.begin(), encoded.end());
+    entry.student.subjects = SubjectList::adopt(string_view(entry.bytes.data(), entry.bytes.size()));
+}
+
+const Student &lazyGet(int index)
+{
+    auto dirty = lazyDirty.find(index);
+    if (dirty != lazyDirty.end())
+        return dirty->second;
+
+    auto cached = lazyLruPos.find(index);
+    if (cached != lazyLruPos.end())
+    {
+        lazyLru.splice(lazyLru.begin(), lazyLru, cached->second);
+        return cached->second->student;
+    }
+
+    lazyLru.push_front(LazyEntry{index, Student(), {}});
+    decodeRecord(lazyLru.front());
+    lazyLruPos[index] = lazyLru.begin();
+
+    if ((int)lazyLru.size() > LAZY_CACHE_CAPACITY)
+    {
+        lazyLruPos.erase(lazyLru.back().index);
+        lazyLru.pop_back();
+    }
+    return lazyLru.front().student;
+}
+
+Student lazyCopy(int index)
+{
+    Student copy = lazyGet(index);
+    ownStudentFields(copy);
+    return copy;
+}
+
+Student &lazyEditable(int index)
+{
+    auto dirty = lazyDirty.find(index);
+    if (dirty != lazyDirty.end())
+        return dirty->second;
+
+    Student &student = lazyDirty[index];
+    student = lazyCopy(index);
+    auto cached = lazyLruPos.find(index);
+    if (cached != lazyLruPos.end())
+    {
+        lazyLru.erase(cached->second);
+        lazyLruPos.erase(cached);
+    }
+    return student;
+}
+
+static void copyRange(ifstream &in, ofstream &out, uint64_t from, uint64_t to)
+{
+    vector<char> buffer(LAZY_IO_CHUNK);
+    in.clear();
+    in.seekg(from);
+    while (from < to)
+    {
+        size_t n = (size_t)min<uint64_t>(buffer.size(), to - from);
+        in.read(buffer.data(), n);
+        out.write(buffer.data(), n);
+        from += n;
+    }
+}
+
+static void writeShiftedOffsets(ofstream &idx, int64_t first, int64_t last, int64_t delta)
+{
+    vector<uint64_t> offsets;
+    for (int64_t i = first; i < last; i += 65536)
+    {
+        int64_t n = min<int64_t>(65536, last - i);
+        readOffsets(i, n, offsets);
+        for (auto &offset : offsets)
+            offset += delta;
+        idx.write((char *)offsets.data(), n * sizeof(uint64_t));
+    }
+}
+
+static bool saveSlotsInPlace()
+{
+    vector<pair<int64_t, const Student *>> records;
+    records.reserve(lazyDirty.size());
+    for (auto &entry : lazyDirty)
+    {
+        uint64_t begin = 0;
+        uint64_t end = 0;
+        if (!recordSpan(entry.first, begin, end))
+        {
+            cout << "Ошибка: не удалось обновить запись " << entry.first + 1 << ".\n";
+            return false;
+        }
+        records.emplace_back((begin - binarySlotOffset(0)) / sizeof(BinaryStoreSlot), &entry.second);
+    }
+    long long bytes = 0;
+    if (!rewriteBinarySlots(lazyPath, records, bytes))
+    {
+        cout << "Ошибка: не удалось обновить записи бинарного файла.\n";
+        return false;
+    }
+
+    string path = lazyPath;
+    int64_t count = lazyCount;
+    closeLazyStore();
+    fstream header(indexPathFor(path), ios::binary | ios::in | ios::out);
+    writeIndexHeader(header, path, true, count);
+    header.close();
+    return openLazyStore(path, true);
+}
+
+// Saves splice unchanged byte ranges at the offsets indexed on open, which is
+// only sound while the file is still the one that was opened.
+static bool lazyFileChanged()
+{
+    RosterVersion current = observeRoster(lazyPath, lazyBinary);
+    return !indexIsFresh(lazyPath, lazyBinary) || current.generation != lazyVersion.generation ||
+           current.size != lazyVersion.size || current.time != lazyVersion.time;
+}
+
+bool saveLazyStore()
+{
+    if (!lazyOpen)
+        return false;
+    if (lazyDirty.empty())
+        return true;
+    if (lazySnapshot)
+        return false;
+    if (lazyFileChanged())
+    {
+        cout << "Ошибка: файл " << lazyPath << " изменён другим процессом после открытия, правки не сохранены. "
+             << "Откройте файл заново и повторите их.\n";
+        return false;
+    }
+    if (lazySlots)
+        return saveSlotsInPlace();
+    if (lazyBinary)
+    {
+        for (auto &entry : lazyDirty)
+        {
+            if (entry.second.subjects.size() > LEGACY_BINARY_SUBJECTS)
+            {
+                cout << "Ошибка: запись " << entry.first + 1 << " содержит больше " << LEGACY_BINARY_SUBJECTS
+                     << " предметов, старый бинарный формат их не вмещает. Загрузите файл полностью и сохраните.\n";
+                return false;
+            }
+        }
+    }
+
+    string idxPath = indexPathFor(lazyPath);
+    string tmpPath = lazyPath + ".tmp";
+    string tmpIdxPath = idxPath + ".tmp";
+    ofstream out(tmpPath, ios::binary | ios::trunc);
+    ofstream idx(tmpIdxPath, ios::binary | ios::trunc);
+    if (!out || !idx)
+    {
+        cout << "Ошибка: не удалось открыть файл для записи.\n";
+        return false;
+    }
+
+    LazyIndexHeader placeholder = {};
+    idx.write((char *)&placeholder, sizeof(placeholder));
+
+    uint64_t srcPos = 0;
+    int64_t next = 0;
+    vector<uint64_t> span;
+    for (auto &entry : lazyDirty)
+    {
+        int64_t d = entry.first;
+        readOffsets(d, 2, span);
+        uint64_t outStart = out.tellp();
+        copyRange(lazyData, out, srcPos, span[0]);
+        writeShiftedOffsets(idx, next, d, (int64_t)outStart - (int64_t)srcPos);
+
+        uint64_t recordStart = out.tellp();
+        idx.write((char *)&recordStart, sizeof(recordStart));
+        if (lazyBinary)
+            writeBinaryStudent(out, entry.second);
+        else
+            writeTextStudent(out, entry.second);
+
+        srcPos = span[1];
+        next = d + 1;
+    }
+
+    uint64_t outStart = out.tellp();
+    uint64_t srcEnd = filesystem::file_size(lazyPath);
+    copyRange(lazyData, out, srcPos, srcEnd);
+    writeShiftedOffsets(idx, next, lazyCount, (int64_t)outStart - (int64_t)srcPos);
+    uint64_t outEnd = out.tellp();
+    idx.write((char *)&outEnd, sizeof(outEnd));
+    out.close();
+    idx.close();
+
+    string path = lazyPath;
+    bool binary = lazyBinary;
+    int64_t count = lazyCount;
+    closeLazyStore();
+
+    error_code ec;
+    filesystem::rename(tmpPath, path, ec);
+    if (ec)
+    {
+        cout << "Ошибка: не удалось заменить файл " << path << ".\n";
+        return false;
+    }
+    fstream header(tmpIdxPath, ios::binary | ios::in | ios::out);
+    writeIndexHeader(header, path, binary, count);
+    header.close();
+    filesystem::rename(tmpIdxPath, idxPath, ec);
+
+    return openLazyStore(path, binary);
+}
+
+size_t lazyCacheBytes()
+{
+    size_t bytes = nodeTableBytes(lazyLru) + hashTableBytes(lazyLruPos) + nodeTableBytes(lazyDirty) +
+                   vectorBytes(lazyOffsetBlock) + stringBytes(lazyWindow);
+    for (const LazyEntry &entry : lazyLru)
+        bytes += vectorBytes(entry.bytes);
+    return bytes;
+}
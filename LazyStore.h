@@ -0,0 +1,30 @@
+#ifndef UTP_LAZYSTORE_H
+#define UTP_LAZYSTORE_H
+
+#include <string>
+#include "Snapshot.h"
+#include "Student.h"
+
+const int LAZY_CACHE_CAPACITY = 4096;
+const int LAZY_PAGE_SIZE = 20;
+
+bool openLazyStore(const std::string &path, bool binary);
+// Serves records from the snapshot mapped by mapSnapshot(); it cannot save,
+// so edits load the whole roster first.
+bool openLazySnapshot(const SnapshotSource &source, int count);
+bool lazyStoreSnapshot();
+void closeLazyStore();
+bool lazyStoreActive();
+bool lazyStoreBinary();
+int lazyRecordCount();
+
+// The reference, and the subject block it points into, live only until the entry is evicted.
+const Student &lazyGet(int index);
+// A copy that owns its subject block, for callers that keep the record across other lookups.
+Student lazyCopy(int index);
+Student &lazyEditable(int index);
+bool saveLazyStore();
+
+size_t lazyCacheBytes();
+
+#endif
@@ -0,0 +1,102 @@
+#include "Memory.h"
+#include "Arena.h"
+#include "BinaryStore.h"
+#include "DisplayWidth.h"
+#include "Duplicates.h"
+#include "InlineString.h"
+#include "LazyStore.h"
+#include "NameIndex.h"
+#include "RangeIndex.h"
+#include "SlotMap.h"
+#include "SortViews.h"
+#include "SurnameIndex.h"
+#include "VersionStore.h"
+
+#include <charconv>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+size_t memoryBudget = 0;
+
+static const char *POOL_NAMES[MEMORY_POOL_COUNT] = {"Записи", "Строки", "Индексы", "Кэши"};
+
+size_t MemoryUsage::total() const
+{
+    size_t sum = 0;
+    for (int pool = 0; pool < MEMORY_POOL_COUNT; pool++)
+        sum += pools[pool];
+    return sum;
+}
+
+// A bare number is MiB; K, M and G suffixes pick the unit explicitly.
+bool parseMemoryBudget(const string &text, size_t &bytes)
+{
+    size_t value = 0;
+    auto parsed = from_chars(text.data(), text.data() + text.size(), value);
+    if (parsed.ec != errc() || parsed.ptr == text.data())
+        return false;
+    string unit(parsed.ptr, text.data() + text.size());
+    int shift = unit.empty() || unit == "M" || unit == "m" ? 20 : unit == "G" || unit == "g" ? 30 : unit == "K" || unit == "k" ? 10 : -1;
+    if (shift < 0 || value > (SIZE_MAX >> shift))
+        return false;
+    bytes = value << shift;
+    return true;
+}
+
+bool memoryBudgetAllows(size_t bytes)
+{
+    return memoryBudget == 0 || bytes <= memoryBudget;
+}
+
+string formatBytes(size_t bytes)
+{
+    ostringstream out;
+    out << fixed << setprecision(1);
+    if (bytes >= (1 << 30))
+        out << bytes / double(1 << 30) << " ГиБ";
+    else if (bytes >= (1 << 20))
+        out << bytes / double(1 << 20) << " МиБ";
+    else if (bytes >= (1 << 10))
+        out << bytes / double(1 << 10) << " КиБ";
+    else
+        out << bytes << " байт";
+    return out.str();
+}
+
+MemoryUsage measureMemory(size_t recordBytes)
+{
+    MemoryUsage usage;
+    usage.pools[MEMORY_RECORDS] = recordBytes;
+    usage.pools[MEMORY_STRINGS] = stringArenaBytes() + inlineNameHeapBytes();
+    usage.pools[MEMORY_INDEXES] =
+        nameIndexBytes() + surnameIndexBytes() + sortViewBytes() + rangeIndexBytes() + identityIndexBytes() +
+        studentIdBytes() + binaryStoreTableBytes();
+    usage.pools[MEMORY_CACHES] = lazyCacheBytes() + displayWidthCacheBytes() + rosterVersionBytes();
+    usage.mapped = mappedArenaBytes();
+    return usage;
+}
+
+void printMemoryReport(const MemoryUsage &usage, int liveStudents)
+{
+    cout << "\nПамять (студентов в памяти: " << liveStudents << "):\n";
+    for (int pool = 0; pool < MEMORY_POOL_COUNT; pool++)
+    {
+        cout << POOL_NAMES[pool] << ": " << formatBytes(usage.pools[pool]);
+        if (liveStudents > 0)
+            cout << ", " << usage.pools[pool] / liveStudents << " байт на студента";
+        cout << "\n";
+    }
+    cout << "Всего: " << formatBytes(usage.total());
+    if (liveStudents > 0)
+        cout << ", " << usage.total() / liveStudents << " байт на студента";
+    cout << "\n";
+    cout << "Отображено из снимка: " << formatBytes(usage.mapped) << "\n";
+    if (memoryBudget == 0)
+        cout << "Бюджет памяти: не ограничен\n";
+    else
+        cout << "Бюджет памяти: " << formatBytes(memoryBudget) << ", занято " << usage.total() * 100 / memoryBudget
+             << "%\n";
+}
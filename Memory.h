@@ -0,0 +1,61 @@
+#ifndef UTP_MEMORY_H
+#define UTP_MEMORY_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+enum MemoryPool
+{
+    MEMORY_RECORDS,
+    MEMORY_STRINGS,
+    MEMORY_INDEXES,
+    MEMORY_CACHES,
+    MEMORY_POOL_COUNT
+};
+
+struct MemoryUsage
+{
+    std::size_t pools[MEMORY_POOL_COUNT];
+    std::size_t mapped;
+
+    std::size_t total() const;
+};
+
+// Heap limit in bytes for the in-memory roster, 0 when unlimited. Mapped
+// snapshot pages are file-backed and do not count against it.
+extern std::size_t memoryBudget;
+
+bool parseMemoryBudget(const std::string &text, std::size_t &bytes);
+bool memoryBudgetAllows(std::size_t bytes);
+std::string formatBytes(std::size_t bytes);
+
+MemoryUsage measureMemory(std::size_t recordBytes);
+void printMemoryReport(const MemoryUsage &usage, int liveStudents);
+
+// Estimates of container footprints for the per-module counters; node-based
+// containers are charged their payload plus two pointers per node.
+template <typename T>
+std::size_t vectorBytes(const std::vector<T> &v)
+{
+    return v.capacity() * sizeof(T);
+}
+
+template <typename Table>
+std::size_t nodeTableBytes(const Table &table)
+{
+    return table.size() * (sizeof(typename Table::value_type) + 2 * sizeof(void *));
+}
+
+template <typename Table>
+std::size_t hashTableBytes(const Table &table)
+{
+    return table.bucket_count() * sizeof(void *) + nodeTableBytes(table);
+}
+
+inline std::size_t stringBytes(const std::string &s)
+{
+    return s.capacity() > 15 ? s.capacity() + 1 : 0;
+}
+
+#endif
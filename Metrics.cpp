@@ -0,0 +1,219 @@
+#include "Metrics.h"
+
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <iostream>
+
+using namespace std;
+
+bool metricsEnabled = true;
+
+static MetricStats metrics[METRIC_OP_COUNT];
+static long long reallocations = 0;
+static long long reallocationBytes = 0;
+
+static const char *METRIC_NAMES[METRIC_OP_COUNT] = {
+    "loadFromFile",
+    "loadFromBinaryFile",
+    "loadFromSnapshot",
+    "saveToFile",
+    "saveToBinaryFile",
+    "sortStudents",
+    "analyzeGrades",
+    "printArray",
+    "expandArray",
+    "validators"};
+
+static int bucketOf(long long ns)
+{
+    int bucket = 0;
+    while (ns > 0 && bucket < METRIC_BUCKETS - 1)
+    {
+        ns >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+static long long bucketUpperNs(int bucket)
+{
+    return bucket == 0 ? 0 : (1LL << bucket) - 1;
+}
+
+static long long percentileNs(const MetricStats &stats, double p)
+{
+    if (stats.count == 0)
+        return 0;
+    long long target = (long long)(p * stats.count + 0.5);
+    if (target < 1)
+        target = 1;
+    long long seen = 0;
+    for (int b = 0; b < METRIC_BUCKETS; b++)
+    {
+        seen += stats.buckets[b];
+        if (seen >= target)
+            return min(bucketUpperNs(b), stats.maxNs);
+    }
+    return stats.maxNs;
+}
+
+void metricRecord(MetricOp op, long long ns)
+{
+    MetricStats &stats = metrics[op];
+    if (stats.count == 0 || ns < stats.minNs)
+        stats.minNs = ns;
+    if (ns > stats.maxNs)
+        stats.maxNs = ns;
+    stats.count++;
+    stats.totalNs += ns;
+    stats.buckets[bucketOf(ns)]++;
+}
+
+void metricCount(MetricOp op)
+{
+    if (metricsEnabled)
+        metrics[op].calls++;
+}
+
+void metricAddRecords(MetricOp op, long long records)
+{
+    if (metricsEnabled)
+        metrics[op].records += records;
+}
+
+void metricAddBytes(MetricOp op, long long bytes)
+{
+    if (metricsEnabled)
+        metrics[op].bytes += bytes;
+}
+
+void metricAddReallocation(long long bytes)
+{
+    if (!metricsEnabled)
+        return;
+    reallocations++;
+    reallocationBytes += bytes;
+}
+
+const MetricStats &metricStats(MetricOp op)
+{
+    return metrics[op];
+}
+
+static long long bytesRead()
+{
+    return metrics[METRIC_LOAD_TEXT].bytes + metrics[METRIC_LOAD_BINARY].bytes;
+}
+
+static long long bytesWritten()
+{
+    return metrics[METRIC_SAVE_TEXT].bytes + metrics[METRIC_SAVE_BINARY].bytes;
+}
+
+static string formatNs(long long ns)
+{
+    ostringstream out;
+    out << fixed << setprecision(2);
+    if (ns >= 1000000000)
+        out << ns / 1e9 << " с";
+    else if (ns >= 1000000)
+        out << ns / 1e6 << " мс";
+    else if (ns >= 1000)
+        out << ns / 1e3 << " мкс";
+    else
+        out << ns << " нс";
+    return out.str();
+}
+
+void printMetrics()
+{
+    if (!metricsEnabled)
+    {
+        cout << "Сбор статистики отключён.\n";
+        return;
+    }
+
+    cout << "\nСтатистика операций:\n";
+    for (int op = 0; op < METRIC_OP_COUNT; op++)
+    {
+        const MetricStats &stats = metrics[op];
+        if (stats.calls > 0)
+            cout << METRIC_NAMES[op] << ": вызовов " << stats.calls << " (без замера времени)\n";
+        if (stats.count == 0)
+            continue;
+        cout << METRIC_NAMES[op] << ": вызовов " << stats.count
+             << ", всего " << formatNs(stats.totalNs)
+             << ", мин " << formatNs(stats.minNs)
+             << ", p50 " << formatNs(percentileNs(stats, 0.50))
+             << ", p95 " << formatNs(percentileNs(stats, 0.95))
+             << ", p99 " << formatNs(percentileNs(stats, 0.99))
+             << ", макс " << formatNs(stats.maxNs);
+        if (stats.records > 0)
+            cout << ", записей " << stats.records;
+        if (stats.bytes > 0)
+            cout << ", байт " << stats.bytes;
+        cout << "\n";
+    }
+    cout << "Прочитано байт: " << bytesRead() << "\n";
+    cout << "Записано байт: " << bytesWritten() << "\n";
+    cout << "Перевыделений массива: " << reallocations << " (" << reallocationBytes << " байт)\n";
+}
+
+void writeMetricsJson(ostream &out)
+{
+    out << "{\"operations\":{";
+    bool first = true;
+    for (int op = 0; op < METRIC_OP_COUNT; op++)
+    {
+        const MetricStats &stats = metrics[op];
+        if (!first)
+            out << ",";
+        first = false;
+        out << "\"" << METRIC_NAMES[op] << "\":{"
+            << "\"count\":" << stats.count
+            << ",\"calls\":" << stats.calls
+            << ",\"totalNs\":" << stats.totalNs
+            << ",\"minNs\":" << stats.minNs
+            << ",\"maxNs\":" << stats.maxNs
+            << ",\"p50Ns\":" << percentileNs(stats, 0.50)
+            << ",\"p95Ns\":" << percentileNs(stats, 0.95)
+            << ",\"p99Ns\":" << percentileNs(stats, 0.99)
+            << ",\"records\":" << stats.records
+            << ",\"bytes\":" << stats.bytes
+            << ",\"histogram\":[";
+        bool firstBucket = true;
+        for (int b = 0; b < METRIC_BUCKETS; b++)
+        {
+            if (stats.buckets[b] == 0)
+                continue;
+            if (!firstBucket)
+                out << ",";
+            firstBucket = false;
+            out << "{\"leNs\":" << bucketUpperNs(b) << ",\"count\":" << stats.buckets[b] << "}";
+        }
+        out << "]}";
+    }
+    out << "},\"bytesRead\":" << bytesRead()
+        << ",\"bytesWritten\":" << bytesWritten()
+        << ",\"reallocations\":" << reallocations
+        << ",\"reallocationBytes\":" << reallocationBytes
+        << "}\n";
+}
+
+bool dumpMetricsJson(const string &path)
+{
+    if (path == "-")
+    {
+        writeMetricsJson(cout);
+        return true;
+    }
+    ofstream out(path);
+    if (!out)
+    {
+        cout << "Ошибка: не удалось открыть файл " << path << " для записи.\n";
+        return false;
+    }
+    writeMetricsJson(out);
+    return (bool)out;
+}
@@ -0,0 +1,66 @@
+#ifndef UTP_METRICS_H
+#define UTP_METRICS_H
+
+#include <chrono>
+#include <ostream>
+#include <string>
+
+enum MetricOp
+{
+    METRIC_LOAD_TEXT,
+    METRIC_LOAD_BINARY,
+    METRIC_LOAD_SNAPSHOT,
+    METRIC_SAVE_TEXT,
+    METRIC_SAVE_BINARY,
+    METRIC_SORT,
+    METRIC_ANALYTICS,
+    METRIC_PRINT,
+    METRIC_EXPAND,
+    METRIC_VALIDATE,
+    METRIC_OP_COUNT
+};
+
+const int METRIC_BUCKETS = 64;
+
+struct MetricStats
+{
+    long long count;
+    long long calls;
+    long long totalNs;
+    long long minNs;
+    long long maxNs;
+    long long records;
+    long long bytes;
+    long long buckets[METRIC_BUCKETS];
+};
+
+extern bool metricsEnabled;
+
+void metricRecord(MetricOp op, long long ns);
+// Counts a call without timing it, for checks cheaper than reading the clock.
+void metricCount(MetricOp op);
+void metricAddRecords(MetricOp op, long long records);
+void metricAddBytes(MetricOp op, long long bytes);
+void metricAddReallocation(long long bytes);
+const MetricStats &metricStats(MetricOp op);
+
+void printMetrics();
+void writeMetricsJson(std::ostream &out);
+bool dumpMetricsJson(const std::string &path);
+
+struct MetricTimer
+{
+    MetricOp op;
+    std::chrono::steady_clock::time_point start;
+
+    explicit MetricTimer(MetricOp op)
+        : op(op), start(metricsEnabled ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point()) {}
+
+    ~MetricTimer()
+    {
+        if (metricsEnabled)
+            metricRecord(op, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+    }
+};
+
+#endif
@@ -0,0 +1,352 @@
+#include "NameIndex.h"
+#include "Memory.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace std;
+
+static const char *CYRILLIC_LATIN[32] = {
+    "a", "b", "v", "g", "d", "e", "zh", "z", "i", "y", "k", "l", "m", "n", "o", "p",
+    "r", "s", "t", "u", "f", "kh", "ts", "ch", "sh", "shch", "", "y", "", "e", "yu", "ya"};
+
+static unordered_map<string, int> termIds;
+static vector<string> terms;
+static vector<vector<int>> termEntries;
+static unordered_map<uint32_t, vector<int>> gramTerms;
+static vector<vector<int>> entryTerms;
+
+string foldName(string_view s)
+{
+    string out;
+    out.reserve(s.size());
+    for (size_t i = 0; i < s.size();)
+    {
+        unsigned char c = s[i];
+        if (c < 0x80)
+        {
+            if (c >= 'A' && c <= 'Z')
+                out.push_back(c - 'A' + 'a');
+            else if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9'))
+                out.push_back(c);
+            else if (!out.empty() && out.back() != ' ')
+                out.push_back(' ');
+            i++;
+            continue;
+        }
+
+        int len = 1;
+        unsigned int cp = 0;
+        if ((c & 0xE0) == 0xC0)
+        {
+            len = 2;
+            cp = c & 0x1F;
+        }
+        else if ((c & 0xF0) == 0xE0)
+        {
+            len = 3;
+            cp = c & 0x0F;
+        }
+        else if ((c & 0xF8) == 0xF0)
+        {
+            len = 4;
+            cp = c & 0x07;
+        }
+        if (i + len > s.size())
+            break;
+        for (int k = 1; k < len; k++)
+            cp = (cp << 6) | (s[i + k] & 0x3F);
+
+        if (cp >= 0x410 && cp <= 0x42F)
+            cp += 0x20;
+        if (cp == 0x401 || cp == 0x451)
+            out.push_back('e');
+        else if (cp >= 0x430 && cp <= 0x44F)
+            out += CYRILLIC_LATIN[cp - 0x430];
+        else
+            out.append(s.substr(i, len));
+        i += len;
+    }
+    while (!out.empty() && out.back() == ' ')
+        out.pop_back();
+    return out;
+}
+
+int boundedEditDistance(const string &a, const string &b, int limit)
+{
+    int n = a.size();
+    int m = b.size();
+    if (abs(n - m) > limit)
+        return limit + 1;
+
+    vector<int> prev(m + 1);
+    vector<int> cur(m + 1);
+    for (int j = 0; j <= m; j++)
+        prev[j] = j;
+
+    for (int i = 1; i <= n; i++)
+    {
+        int from = max(1, i - limit);
+        int to = min(m, i + limit);
+        cur[0] = i;
+        if (from > 1)
+            cur[from - 1] = limit + 1;
+        int rowBest = from > 1 ? limit + 1 : i;
+        for (int j = from; j <= to; j++)
+        {
+            int cost = a[i - 1] == b[j - 1] ? 0 : 1;
+            int best = prev[j - 1] + cost;
+            if (j < i + limit && prev[j] + 1 < best)
+                best = prev[j] + 1;
+            if (cur[j - 1] + 1 < best)
+                best = cur[j - 1] + 1;
+            cur[j] = best;
+            rowBest = min(rowBest, best);
+        }
+        if (to < m)
+            cur[to + 1] = limit + 1;
+        if (rowBest > limit)
+            return limit + 1;
+        swap(prev, cur);
+    }
+    return min(prev[m], limit + 1);
+}
+
+static vector<string> splitWords(const string &folded)
+{
+    vector<string> words;
+    size_t start = 0;
+    while (start < folded.size())
+    {
+        size_t end = folded.find(' ', start);
+        if (end == string::npos)
+            end = folded.size();
+        if (end > start)
+            words.push_back(folded.substr(start, end - start));
+        start = end + 1;
+    }
+    return words;
+}
+
+static vector<uint32_t> trigramsOf(const string &word)
+{
+    string padded = "$$" + word + "$$";
+    vector<uint32_t> grams;
+    for (size_t i = 0; i + 3 <= padded.size(); i++)
+    {
+        grams.push_back(((uint32_t)(unsigned char)padded[i] << 16) |
+                        ((uint32_t)(unsigned char)padded[i + 1] << 8) |
+                        (uint32_t)(unsigned char)padded[i + 2]);
+    }
+    sort(grams.begin(), grams.end());
+    grams.erase(unique(grams.begin(), grams.end()), grams.end());
+    return grams;
+}
+
+static int internTerm(const string &word)
+{
+    auto found = termIds.find(word);
+    if (found != termIds.end())
+        return found->second;
+
+    int id = terms.size();
+    termIds.emplace(word, id);
+    terms.push_back(word);
+    termEntries.emplace_back();
+    for (uint32_t gram : trigramsOf(word))
+        gramTerms[gram].push_back(id);
+    return id;
+}
+
+static vector<int> termsOf(const Student &student)
+{
+    vector<int> ids;
+    for (const InlineName *field : {&student.surname, &student.name, &student.middleName})
+    {
+        for (const string &word : splitWords(foldName(*field)))
+            ids.push_back(internTerm(word));
+    }
+    sort(ids.begin(), ids.end());
+    ids.erase(unique(ids.begin(), ids.end()), ids.end());
+    return ids;
+}
+
+static void unlinkEntry(int index)
+{
+    for (int term : entryTerms[index])
+    {
+        vector<int> &entries = termEntries[term];
+        auto it = find(entries.begin(), entries.end(), index);
+        if (it != entries.end())
+        {
+            *it = entries.back();
+            entries.pop_back();
+        }
+    }
+    entryTerms[index].clear();
+}
+
+static void linkEntry(int index, const Student &student)
+{
+    entryTerms[index] = termsOf(student);
+    for (int term : entryTerms[index])
+        termEntries[term].push_back(index);
+}
+
+void rebuildNameIndex(const Student *arr, int count)
+{
+    termIds.clear();
+    terms.clear();
+    termEntries.clear();
+    gramTerms.clear();
+    entryTerms.assign(count, vector<int>());
+    for (int i = 0; i < count; i++)
+        linkEntry(i, arr[i]);
+}
+
+void nameIndexReorder(const Student *arr, int count)
+{
+    for (auto &entries : termEntries)
+        entries.clear();
+    entryTerms.assign(count, vector<int>());
+    for (int i = 0; i < count; i++)
+        linkEntry(i, arr[i]);
+}
+
+void nameIndexInsert(int index, const Student &student)
+{
+    if (index >= (int)entryTerms.size())
+        entryTerms.resize(index + 1);
+    linkEntry(index, student);
+}
+
+void nameIndexUpdate(int index, const Student &student)
+{
+    if (index >= (int)entryTerms.size())
+        entryTerms.resize(index + 1);
+    unlinkEntry(index);
+    linkEntry(index, student);
+}
+
+void nameIndexErase(int index)
+{
+    if (index >= (int)entryTerms.size())
+        return;
+    unlinkEntry(index);
+}
+
+static int editLimitFor(const string &word)
+{
+    if (word.size() <= 4)
+        return 1;
+    if (word.size() <= 8)
+        return 2;
+    return 3;
+}
+
+static unordered_map<int, int> matchWord(const string &word)
+{
+    int limit = editLimitFor(word);
+    vector<uint32_t> grams = trigramsOf(word);
+    int threshold = (int)grams.size() - 3 * limit;
+
+    vector<int> candidates;
+    if (threshold <= 0)
+    {
+        candidates.resize(terms.size());
+        for (size_t t = 0; t < terms.size(); t++)
+            candidates[t] = t;
+    }
+    else
+    {
+        vector<const vector<int> *> lists;
+        for (uint32_t gram : grams)
+        {
+            auto found = gramTerms.find(gram);
+            lists.push_back(found == gramTerms.end() ? nullptr : &found->second);
+        }
+        sort(lists.begin(), lists.end(), [](const vector<int> *a, const vector<int> *b) {
+            return (a ? a->size() : 0) < (b ? b->size() : 0);
+        });
+
+        unordered_set<int> seen;
+        for (size_t i = 0; i < grams.size() - threshold + 1; i++)
+        {
+            if (!lists[i])
+                continue;
+            for (int term : *lists[i])
+            {
+                if (seen.insert(term).second)
+                    candidates.push_back(term);
+            }
+        }
+    }
+
+    unordered_map<int, int> best;
+    for (int term : candidates)
+    {
+        if (termEntries[term].empty())
+            continue;
+        int distance = boundedEditDistance(word, terms[term], limit);
+        if (distance > limit)
+            continue;
+        for (int entry : termEntries[term])
+        {
+            auto it = best.find(entry);
+            if (it == best.end() || distance < it->second)
+                best[entry] = distance;
+        }
+    }
+    return best;
+}
+
+vector<NameMatch> fuzzySearchNames(const string &query, int limit)
+{
+    vector<string> words = splitWords(foldName(query));
+    vector<NameMatch> matches;
+    if (words.empty())
+        return matches;
+
+    unordered_map<int, int> total = matchWord(words[0]);
+    for (size_t w = 1; w < words.size() && !total.empty(); w++)
+    {
+        unordered_map<int, int> next = matchWord(words[w]);
+        for (auto it = total.begin(); it != total.end();)
+        {
+            auto found = next.find(it->first);
+            if (found == next.end())
+            {
+                it = total.erase(it);
+                continue;
+            }
+            it->second += found->second;
+            ++it;
+        }
+    }
+
+    for (const auto &entry : total)
+        matches.push_back({entry.first, entry.second});
+    sort(matches.begin(), matches.end(), [](const NameMatch &a, const NameMatch &b) {
+        return a.distance != b.distance ? a.distance < b.distance : a.index < b.index;
+    });
+    if ((int)matches.size() > limit)
+        matches.resize(limit);
+    return matches;
+}
+
+size_t nameIndexBytes()
+{
+    size_t bytes = hashTableBytes(termIds) + vectorBytes(terms) + vectorBytes(termEntries) +
+                   hashTableBytes(gramTerms) + vectorBytes(entryTerms);
+    for (const string &term : terms)
+        bytes += 2 * stringBytes(term);
+    for (const vector<int> &entries : termEntries)
+        bytes += vectorBytes(entries);
+    for (const auto &gram : gramTerms)
+        bytes += vectorBytes(gram.second);
+    for (const vector<int> &entryTermList : entryTerms)
+        bytes += vectorBytes(entryTermList);
+    return bytes;
+}
@@ -0,0 +1,26 @@
+#ifndef UTP_NAMEINDEX_H
+#define UTP_NAMEINDEX_H
+
+#include <string>
+#include <vector>
+#include "Student.h"
+
+struct NameMatch
+{
+    int index;
+    int distance;
+};
+
+std::string foldName(std::string_view s);
+int boundedEditDistance(const std::string &a, const std::string &b, int limit);
+
+void rebuildNameIndex(const Student *arr, int count);
+void nameIndexReorder(const Student *arr, int count);
+void nameIndexInsert(int index, const Student &student);
+void nameIndexUpdate(int index, const Student &student);
+void nameIndexErase(int index);
+
+std::vector<NameMatch> fuzzySearchNames(const std::string &query, int limit);
+size_t nameIndexBytes();
+
+#endif
@@ -0,0 +1,144 @@
+#include "RangeIndex.h"
+#include "Memory.h"
+#include "SlotMap.h"
+
+#include <algorithm>
+#include <charconv>
+
+using namespace std;
+
+const int YEAR_SPAN = STUDENT_YEAR_MAX - STUDENT_YEAR_MIN + 1;
+const int COURSE_SPAN = STUDENT_COURSE_MAX - STUDENT_COURSE_MIN + 1;
+const int OUTSIDE_BUCKET = YEAR_SPAN * COURSE_SPAN;
+
+// One bucket of roster positions per (year, course) pair of the validated
+// domain, plus one for records loaded from files with values outside it.
+static vector<vector<int>> buckets;
+static bool built = false;
+
+static int bucketOf(const Student &student)
+{
+    int year = student.year - STUDENT_YEAR_MIN;
+    int course = student.course - STUDENT_COURSE_MIN;
+    if (year < 0 || year >= YEAR_SPAN || course < 0 || course >= COURSE_SPAN)
+        return OUTSIDE_BUCKET;
+    return year * COURSE_SPAN + course;
+}
+
+static void buildRangeIndex(const Student *arr, int count)
+{
+    buckets.assign(OUTSIDE_BUCKET + 1, vector<int>());
+    for (int i = 0; i < count; i++)
+    {
+        if (arr[i].id != INVALID_STUDENT_ID)
+            buckets[bucketOf(arr[i])].push_back(i);
+    }
+    built = true;
+}
+
+static void addPosition(vector<int> &bucket, int index)
+{
+    bucket.insert(lower_bound(bucket.begin(), bucket.end(), index), index);
+}
+
+static void removePosition(vector<int> &bucket, int index)
+{
+    auto found = lower_bound(bucket.begin(), bucket.end(), index);
+    if (found != bucket.end() && *found == index)
+        bucket.erase(found);
+}
+
+static bool parseNumber(string_view text, int &value)
+{
+    size_t first = text.find_first_not_of(' ');
+    size_t last = text.find_last_not_of(' ');
+    if (first == string_view::npos)
+        return false;
+    text = text.substr(first, last - first + 1);
+    auto parsed = from_chars(text.data(), text.data() + text.size(), value);
+    return parsed.ec == errc() && parsed.ptr == text.data() + text.size();
+}
+
+// "a-b", a single value, or an empty line for the whole [low, high] domain.
+bool parseRange(const string &text, int low, int high, int &from, int &to)
+{
+    if (text.find_first_not_of(' ') == string::npos)
+    {
+        from = low;
+        to = high;
+        return true;
+    }
+    size_t dash = text.find('-');
+    if (dash == string::npos)
+    {
+        if (!parseNumber(text, from))
+            return false;
+        to = from;
+    }
+    else if (!parseNumber(string_view(text).substr(0, dash), from) ||
+             !parseNumber(string_view(text).substr(dash + 1), to))
+        return false;
+    return from <= to;
+}
+
+void resetRangeIndex()
+{
+    buckets.clear();
+    built = false;
+}
+
+void rangeIndexInsert(int index, const Student &student)
+{
+    if (built)
+        addPosition(buckets[bucketOf(student)], index);
+}
+
+void rangeIndexUpdate(int index, const Student &before, const Student &student)
+{
+    if (!built || bucketOf(before) == bucketOf(student))
+        return;
+    removePosition(buckets[bucketOf(before)], index);
+    addPosition(buckets[bucketOf(student)], index);
+}
+
+void rangeIndexErase(int index, const Student &student)
+{
+    if (built)
+        removePosition(buckets[bucketOf(student)], index);
+}
+
+vector<int> rangeQuery(const RangeQuery &query, const Student *arr, int count)
+{
+    if (!built)
+        buildRangeIndex(arr, count);
+
+    vector<int> result;
+    int yearFrom = max(query.yearFrom, STUDENT_YEAR_MIN) - STUDENT_YEAR_MIN;
+    int yearTo = min(query.yearTo, STUDENT_YEAR_MAX) - STUDENT_YEAR_MIN;
+    int courseFrom = max(query.courseFrom, STUDENT_COURSE_MIN) - STUDENT_COURSE_MIN;
+    int courseTo = min(query.courseTo, STUDENT_COURSE_MAX) - STUDENT_COURSE_MIN;
+    for (int year = yearFrom; year <= yearTo; year++)
+    {
+        for (int course = courseFrom; course <= courseTo; course++)
+        {
+            const vector<int> &bucket = buckets[year * COURSE_SPAN + course];
+            result.insert(result.end(), bucket.begin(), bucket.end());
+        }
+    }
+    for (int index : buckets[OUTSIDE_BUCKET])
+    {
+        const Student &student = arr[index];
+        if (student.year >= query.yearFrom && student.year <= query.yearTo && student.course >= query.courseFrom &&
+            student.course <= query.courseTo)
+            result.push_back(index);
+    }
+    return result;
+}
+
+size_t rangeIndexBytes()
+{
+    size_t bytes = vectorBytes(buckets);
+    for (const vector<int> &bucket : buckets)
+        bytes += vectorBytes(bucket);
+    return bytes;
+}
@@ -0,0 +1,33 @@
+#ifndef UTP_RANGEINDEX_H
+#define UTP_RANGEINDEX_H
+
+#include <string>
+#include <vector>
+#include "Student.h"
+
+const int STUDENT_YEAR_MIN = 1930;
+const int STUDENT_YEAR_MAX = 2010;
+const int STUDENT_COURSE_MIN = 1;
+const int STUDENT_COURSE_MAX = 6;
+
+struct RangeQuery
+{
+    int yearFrom;
+    int yearTo;
+    int courseFrom;
+    int courseTo;
+};
+
+bool parseRange(const std::string &text, int low, int high, int &from, int &to);
+
+void resetRangeIndex();
+void rangeIndexInsert(int index, const Student &student);
+void rangeIndexUpdate(int index, const Student &before, const Student &student);
+void rangeIndexErase(int index, const Student &student);
+
+// Positions ordered by year, then course, then roster position; records with
+// values outside the validated domain come last.
+std::vector<int> rangeQuery(const RangeQuery &query, const Student *arr, int count);
+size_t rangeIndexBytes();
+
+#endif
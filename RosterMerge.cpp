@@ -0,0 +1,191 @@
+#include "RosterMerge.h"
+#include "SlotMap.h"
+
+#include <filesystem>
+#include <map>
+#include <unordered_map>
+
+using namespace std;
+
+struct TrackedChange
+{
+    bool existed;
+    Student before;
+};
+
+struct RosterBase
+{
+    RosterVersion version;
+    map<uint64_t, TrackedChange> tracked;
+};
+
+static unordered_map<string, RosterBase> bases;
+
+RosterVersion observeRosterFile(const string &path, uint64_t generation)
+{
+    RosterVersion version = {path, generation, -1, 0};
+    error_code ec;
+    auto size = filesystem::file_size(path, ec);
+    if (ec)
+        return version;
+    version.size = (int64_t)size;
+    auto time = filesystem::last_write_time(path, ec);
+    if (!ec)
+        version.time = (int64_t)time.time_since_epoch().count();
+    return version;
+}
+
+void resetRosterBases()
+{
+    bases.clear();
+}
+
+void setRosterBase(const RosterVersion &version)
+{
+    RosterBase &base = bases[version.path];
+    base.version = version;
+    base.tracked.clear();
+}
+
+// Moves the base to a version whose external changes were already applied,
+// keeping the local edits that are still unsaved.
+void advanceRosterBase(const RosterVersion &version)
+{
+    bases[version.path].version = version;
+}
+
+bool rosterBaseStale(const RosterVersion &current)
+{
+    auto found = bases.find(current.path);
+    if (found == bases.end())
+        return false;
+    const RosterVersion &known = found->second.version;
+    return current.generation != known.generation || current.size != known.size || current.time != known.time;
+}
+
+bool rosterBaseIs(const RosterVersion &version)
+{
+    auto found = bases.find(version.path);
+    return found != bases.end() && !rosterBaseStale(version);
+}
+
+uint64_t nextRosterGeneration(const RosterVersion &current)
+{
+    uint64_t generation = current.generation;
+    auto found = bases.find(current.path);
+    if (found != bases.end() && found->second.version.generation > generation)
+        generation = found->second.version.generation;
+    return generation + 1;
+}
+
+void trackRosterInsert(uint64_t id)
+{
+    for (auto &base : bases)
+        base.second.tracked.emplace(id, TrackedChange{false, Student()});
+}
+
+void trackRosterChange(uint64_t id, const Student &before)
+{
+    for (auto &base : bases)
+        base.second.tracked.emplace(id, TrackedChange{true, before});
+}
+
+static string recordKey(const Student &student)
+{
+    string key = to_string(student.year) + '\x1f' + to_string(student.course);
+    for (string_view field : {(string_view)student.name, (string_view)student.surname, (string_view)student.middleName})
+    {
+        key += '\x1f';
+        key += field;
+    }
+    key += '\x1f';
+    key += student.subjects.encoded();
+    return key;
+}
+
+uint64_t rosterRecordHash(const Student &student)
+{
+    uint64_t hash = 1469598103934665603ULL;
+    auto mix = [&](string_view bytes) {
+        for (char c : bytes)
+        {
+            hash ^= (unsigned char)c;
+            hash *= 1099511628211ULL;
+        }
+        hash ^= 0x1f;
+        hash *= 1099511628211ULL;
+    };
+    mix(string_view((const char *)&student.year, sizeof(student.year)));
+    mix(string_view((const char *)&student.course, sizeof(student.course)));
+    mix(student.name);
+    mix(student.surname);
+    mix(student.middleName);
+    mix(student.subjects.encoded());
+    return hash;
+}
+
+bool sameRosterRecord(const Student &a, const Student &b)
+{
+    return a.year == b.year && a.course == b.course && string_view(a.name) == string_view(b.name) &&
+           string_view(a.surname) == string_view(b.surname) &&
+           string_view(a.middleName) == string_view(b.middleName) && a.subjects.encoded() == b.subjects.encoded();
+}
+
+void mergeRoster(const string &path, vector<Student> &disk, const Student *arr, RosterMergeStats &stats)
+{
+    stats.applied = 0;
+    stats.conflicts.clear();
+    auto base = bases.find(path);
+    if (base == bases.end())
+        return;
+
+    unordered_multimap<string, size_t> onDisk;
+    onDisk.reserve(disk.size());
+    for (size_t i = 0; i < disk.size(); i++)
+        onDisk.emplace(recordKey(disk[i]), i);
+
+    vector<bool> removed(disk.size(), false);
+    vector<Student> inserted;
+    for (const auto &entry : base->second.tracked)
+    {
+        int position = positionOfStudentId(entry.first);
+        const Student *current = position >= 0 ? &arr[position] : nullptr;
+        const TrackedChange &change = entry.second;
+        if (!change.existed)
+        {
+            if (current)
+            {
+                inserted.push_back(*current);
+                stats.applied++;
+            }
+            continue;
+        }
+
+        string key = recordKey(change.before);
+        if (current && recordKey(*current) == key)
+            continue;
+        auto found = onDisk.find(key);
+        if (found == onDisk.end())
+        {
+            stats.conflicts.push_back(change.before);
+            continue;
+        }
+        size_t index = found->second;
+        onDisk.erase(found);
+        if (current)
+            disk[index] = *current;
+        else
+            removed[index] = true;
+        stats.applied++;
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i < disk.size(); i++)
+    {
+        if (!removed[i])
+            disk[kept++] = move(disk[i]);
+    }
+    disk.resize(kept);
+    for (Student &student : inserted)
+        disk.push_back(move(student));
+}
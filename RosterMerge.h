@@ -0,0 +1,39 @@
+#ifndef UTP_ROSTERMERGE_H
+#define UTP_ROSTERMERGE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Student.h"
+
+struct RosterVersion
+{
+    std::string path;
+    std::uint64_t generation;
+    std::int64_t size;
+    std::int64_t time;
+};
+
+struct RosterMergeStats
+{
+    int applied;
+    std::vector<Student> conflicts;
+};
+
+RosterVersion observeRosterFile(const std::string &path, std::uint64_t generation);
+void resetRosterBases();
+void setRosterBase(const RosterVersion &version);
+void advanceRosterBase(const RosterVersion &version);
+bool rosterBaseStale(const RosterVersion &current);
+bool rosterBaseIs(const RosterVersion &version);
+std::uint64_t nextRosterGeneration(const RosterVersion &current);
+
+void trackRosterInsert(std::uint64_t id);
+void trackRosterChange(std::uint64_t id, const Student &before);
+
+std::uint64_t rosterRecordHash(const Student &student);
+bool sameRosterRecord(const Student &a, const Student &b);
+
+void mergeRoster(const std::string &path, std::vector<Student> &disk, const Student *arr, RosterMergeStats &stats);
+
+#endif
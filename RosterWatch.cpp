@@ -0,0 +1,278 @@
+#include "RosterWatch.h"
+#include "BinaryStore.h"
+#include "FileLock.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <string_view>
+#include <thread>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+bool readWholeFile(const string &path, vector<char> &buffer);
+bool parseTextGeneration(string_view line, uint64_t &generation);
+bool textFormatSupported(string_view text);
+
+struct WatchedLine
+{
+    uint64_t hash;
+    string_view text;
+};
+
+struct WatchedFile
+{
+    vector<char> buffer;
+    vector<WatchedLine> lines;
+    RosterVersion version;
+};
+
+struct WatchTarget
+{
+    RosterVersion loaded;
+    bool binary;
+    bool active;
+};
+
+static mutex watchLock;
+static WatchTarget target = {{string(), 0, -1, 0}, false, false};
+static uint64_t targetEpoch = 0;
+static deque<RosterDelta> deltas;
+static thread watcher;
+static atomic<bool> stopping(false);
+
+static uint64_t lineHash(string_view line)
+{
+    uint64_t hash = 1469598103934665603ULL;
+    for (char c : line)
+    {
+        hash ^= (unsigned char)c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static bool lineBefore(const WatchedLine &a, const WatchedLine &b)
+{
+    return a.hash != b.hash ? a.hash < b.hash : a.text < b.text;
+}
+
+static bool sameVersion(const RosterVersion &a, const RosterVersion &b)
+{
+    return a.generation == b.generation && a.size == b.size && a.time == b.time;
+}
+
+static bool readWatchedFile(const string &path, bool binary, WatchedFile &file)
+{
+    FileLock lock(path, FILE_LOCK_SHARED);
+    file.buffer.clear();
+    file.lines.clear();
+    if (binary)
+    {
+        file.version = observeRosterFile(path, binaryStoreGeneration(path));
+        return file.version.size >= 0;
+    }
+    if (!readWholeFile(path, file.buffer) || !textFormatSupported(string_view(file.buffer.data(), file.buffer.size())))
+        return false;
+    uint64_t generation = 0;
+    const char *p = file.buffer.data();
+    const char *last = p + file.buffer.size();
+    while (p < last)
+    {
+        const char *newline = (const char *)memchr(p, '\n', last - p);
+        string_view line(p, (newline ? newline : last) - p);
+        p = newline ? newline + 1 : last;
+        if (line.empty() || parseTextGeneration(line, generation))
+            continue;
+        file.lines.push_back({lineHash(line), line});
+    }
+    sort(file.lines.begin(), file.lines.end(), lineBefore);
+    file.version = observeRosterFile(path, generation);
+    return true;
+}
+
+// Both line lists are sorted, so one merge pass yields the multiset difference.
+static void diffLines(const WatchedFile &before, const WatchedFile &after, RosterDelta &delta)
+{
+    size_t i = 0;
+    size_t j = 0;
+    while (i < before.lines.size() || j < after.lines.size())
+    {
+        if (j == after.lines.size() || (i < before.lines.size() && lineBefore(before.lines[i], after.lines[j])))
+            delta.removed.emplace_back(before.lines[i++].text);
+        else if (i == before.lines.size() || lineBefore(after.lines[j], before.lines[i]))
+            delta.added.emplace_back(after.lines[j++].text);
+        else
+        {
+            i++;
+            j++;
+        }
+    }
+}
+
+static void postDelta(uint64_t epoch, RosterDelta &&delta)
+{
+    lock_guard<mutex> guard(watchLock);
+    if (epoch == targetEpoch)
+        deltas.push_back(move(delta));
+}
+
+#ifdef __linux__
+static int watchDirectory(int events, int watch, const string &path)
+{
+    if (watch >= 0)
+        inotify_rm_watch(events, watch);
+    string directory = filesystem::path(path).parent_path().string();
+    return inotify_add_watch(events, directory.empty() ? "." : directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+}
+
+static bool waitForChange(int events, const string &path, int timeoutMs)
+{
+    pollfd ready = {events, POLLIN, 0};
+    if (poll(&ready, 1, timeoutMs) <= 0)
+        return false;
+    string name = filesystem::path(path).filename().string();
+    bool changed = false;
+    alignas(inotify_event) char buffer[4096];
+    ssize_t length;
+    while ((length = read(events, buffer, sizeof(buffer))) > 0)
+    {
+        for (char *p = buffer; p < buffer + length;)
+        {
+            const inotify_event *event = (const inotify_event *)p;
+            if ((event->mask & IN_Q_OVERFLOW) || (event->len > 0 && name == event->name))
+                changed = true;
+            p += sizeof(inotify_event) + event->len;
+        }
+    }
+    return changed;
+}
+#else
+static bool waitForChange(const RosterVersion &known, int timeoutMs)
+{
+    this_thread::sleep_for(chrono::milliseconds(timeoutMs));
+    RosterVersion current = observeRosterFile(known.path, known.generation);
+    return current.size != known.size || current.time != known.time;
+}
+#endif
+
+// Runs on its own thread: reading, hashing and diffing the file never block
+// the menu; the interactive thread only applies the resulting delta.
+static void watchLoop()
+{
+    uint64_t epoch = 0;
+    WatchTarget current = {{string(), 0, -1, 0}, false, false};
+    WatchedFile base;
+    bool diverged = false;
+#ifdef __linux__
+    int events = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    int watch = -1;
+#endif
+    while (!stopping)
+    {
+        bool retarget = false;
+        {
+            lock_guard<mutex> guard(watchLock);
+            if (epoch != targetEpoch)
+            {
+                epoch = targetEpoch;
+                current = target;
+                retarget = true;
+            }
+        }
+        if (retarget && current.active)
+        {
+#ifdef __linux__
+            watch = watchDirectory(events, watch, current.loaded.path);
+#endif
+            diverged = !readWatchedFile(current.loaded.path, current.binary, base) ||
+                       !sameVersion(base.version, current.loaded);
+            if (diverged)
+                postDelta(epoch, {current.loaded, base.version, current.binary, true, {}, {}});
+        }
+        if (!current.active)
+        {
+            this_thread::sleep_for(chrono::milliseconds(ROSTER_WATCH_POLL_MS));
+            continue;
+        }
+
+#ifdef __linux__
+        if (!waitForChange(events, current.loaded.path, ROSTER_WATCH_POLL_MS))
+            continue;
+        while (waitForChange(events, current.loaded.path, ROSTER_WATCH_SETTLE_MS))
+            ;
+#else
+        if (!waitForChange(base.version, ROSTER_WATCH_POLL_MS))
+            continue;
+#endif
+        WatchedFile next;
+        if (!readWatchedFile(current.loaded.path, current.binary, next) || sameVersion(next.version, base.version))
+            continue;
+        RosterDelta delta = {base.version, next.version, current.binary, current.binary || diverged, {}, {}};
+        if (!delta.rescan)
+            diffLines(base, next, delta);
+        base = move(next);
+        postDelta(epoch, move(delta));
+    }
+#ifdef __linux__
+    if (events >= 0)
+        close(events);
+#endif
+}
+
+static void retarget(const WatchTarget &next)
+{
+    {
+        lock_guard<mutex> guard(watchLock);
+        target = next;
+        targetEpoch++;
+        deltas.clear();
+    }
+    if (!watcher.joinable())
+        watcher = thread(watchLoop);
+}
+
+void watchRosterFile(const RosterVersion &loaded, bool binary)
+{
+    retarget({loaded, binary, true});
+}
+
+void unwatchRosterFile()
+{
+    if (watcher.joinable())
+        retarget({{string(), 0, -1, 0}, false, false});
+}
+
+void stopRosterWatcher()
+{
+    stopping = true;
+    if (watcher.joinable())
+        watcher.join();
+}
+
+bool takeRosterDelta(RosterDelta &delta)
+{
+    lock_guard<mutex> guard(watchLock);
+    if (deltas.empty())
+        return false;
+    delta = move(deltas.front());
+    deltas.pop_front();
+    return true;
+}
+
+struct WatcherShutdown
+{
+    ~WatcherShutdown() { stopRosterWatcher(); }
+};
+
+static WatcherShutdown watcherShutdown;
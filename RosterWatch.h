@@ -0,0 +1,30 @@
+#ifndef UTP_ROSTERWATCH_H
+#define UTP_ROSTERWATCH_H
+
+#include <string>
+#include <vector>
+#include "RosterMerge.h"
+
+const int ROSTER_WATCH_POLL_MS = 250;
+const int ROSTER_WATCH_SETTLE_MS = 100;
+
+// What changed in the watched roster file since the watcher last read it.
+// Text rosters are diffed line by line; a rescan means the records cannot
+// be diffed (binary files, or the file moved on before the watcher saw the
+// loaded version) and only the save-time merge can reconcile them.
+struct RosterDelta
+{
+    RosterVersion from;
+    RosterVersion version;
+    bool binary;
+    bool rescan;
+    std::vector<std::string> removed;
+    std::vector<std::string> added;
+};
+
+void watchRosterFile(const RosterVersion &loaded, bool binary);
+void unwatchRosterFile();
+void stopRosterWatcher();
+bool takeRosterDelta(RosterDelta &delta);
+
+#endif
@@ -0,0 +1,255 @@
+#include "RoundTrip.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <tuple>
+
+using namespace std;
+
+const size_t NAME_EDGE_BYTES[] = {1, 2, 46, 47, 48, 49, 127};
+const size_t LATIN_LETTERS = 52;
+const int GRADE_COMBINATIONS = 5 + 5 * 5 + 5 * 5 * 5;
+const char *const COMMON_SUBJECTS[] = {"Math", "Физика", "angl", "История", "Химия", "Литература"};
+
+bool RoundTripRecord::operator<(const RoundTripRecord &other) const
+{
+    return tie(year, course, surname, name, middleName, subjects) <
+           tie(other.year, other.course, other.surname, other.name, other.middleName, other.subjects);
+}
+
+bool RoundTripRecord::operator==(const RoundTripRecord &other) const
+{
+    return year == other.year && course == other.course && name == other.name && surname == other.surname &&
+           middleName == other.middleName && subjects == other.subjects;
+}
+
+static vector<string> letterTable()
+{
+    vector<string> letters;
+    for (char c = 'a'; c <= 'z'; c++)
+    {
+        letters.push_back(string(1, c));
+        letters.push_back(string(1, c - 'a' + 'A'));
+    }
+    auto cyrillic = [&](unsigned code) {
+        letters.push_back({(char)(0xC0 | code >> 6), (char)(0x80 | (code & 0x3F))});
+    };
+    for (unsigned code = 0x410; code <= 0x44F; code++)
+        cyrillic(code);
+    cyrillic(0x401);
+    cyrillic(0x451);
+    return letters;
+}
+
+// Mostly Cyrillic letters; a Latin letter closes the word when one byte is left.
+static string randomWord(mt19937_64 &rng, size_t bytes)
+{
+    static const vector<string> letters = letterTable();
+    string word;
+    while (word.size() < bytes)
+    {
+        bool latin = bytes - word.size() == 1 || rng() % 5 == 0;
+        size_t i = latin ? rng() % LATIN_LETTERS : LATIN_LETTERS + rng() % (letters.size() - LATIN_LETTERS);
+        word += letters[i];
+    }
+    return word;
+}
+
+static size_t randomNameBytes(mt19937_64 &rng)
+{
+    if (rng() % 4 == 0)
+        return NAME_EDGE_BYTES[rng() % size(NAME_EDGE_BYTES)];
+    return 4 + rng() % 24;
+}
+
+static int randomCount(mt19937_64 &rng, int limit, int typical)
+{
+    if (rng() % 8 == 0)
+        return rng() % 2 ? 1 : limit;
+    return 1 + rng() % typical;
+}
+
+static void combinationGrades(int index, string &grades)
+{
+    int length = index < 5 ? 1 : index < 30 ? 2 : 3;
+    index -= length == 1 ? 0 : length == 2 ? 5 : 30;
+    grades.clear();
+    for (int g = 0; g < length; g++)
+    {
+        grades.push_back(1 + index % 5);
+        index /= 5;
+    }
+}
+
+// The first subjects of every roster walk through all grade lists of length
+// one to three, so even the smallest tier covers each of them.
+vector<RoundTripRecord> generateRoundTripRoster(size_t count, uint64_t seed)
+{
+    mt19937_64 rng(seed);
+    SubjectListBuilder builder;
+    string grades;
+    int combination = 0;
+    vector<RoundTripRecord> records(count);
+    for (RoundTripRecord &record : records)
+    {
+        record.year = 1930 + rng() % 81;
+        record.course = 1 + rng() % 6;
+        record.name = randomWord(rng, randomNameBytes(rng));
+        record.surname = randomWord(rng, randomNameBytes(rng));
+        record.middleName = randomWord(rng, randomNameBytes(rng));
+
+        builder.clear();
+        int subjects = randomCount(rng, MAX_SUBJECTS, 8);
+        for (int j = 0; j < subjects; j++)
+        {
+            string subject = rng() % 2 ? string(COMMON_SUBJECTS[rng() % size(COMMON_SUBJECTS)])
+                                       : randomWord(rng, randomNameBytes(rng));
+            if (combination < GRADE_COMBINATIONS)
+            {
+                combinationGrades(combination++, grades);
+            }
+            else
+            {
+                grades.resize(randomCount(rng, MAX_GRADES_PER_SUBJECT, 6));
+                for (char &grade : grades)
+                    grade = 1 + rng() % 5;
+            }
+            builder.add(subject, GradeSpan{(const uint8_t *)grades.data(), grades.size()});
+        }
+        record.subjects = string(builder.encode());
+    }
+    return records;
+}
+
+RoundTripRecord roundTripRecordOf(const Student &student)
+{
+    return {student.year,
+            student.course,
+            student.name.str(),
+            student.surname.str(),
+            student.middleName.str(),
+            string(student.subjects.encoded())};
+}
+
+void fillStudentFrom(const RoundTripRecord &record, Student &student)
+{
+    student.year = record.year;
+    student.course = record.course;
+    student.name = record.name;
+    student.surname = record.surname;
+    student.middleName = record.middleName;
+    student.subjects = SubjectList::copy(record.subjects);
+}
+
+static string describeMismatch(const vector<RoundTripRecord> &expected, const vector<RoundTripRecord> &actual)
+{
+    if (expected.size() != actual.size())
+        return "ожидалось записей " + to_string(expected.size()) + ", загружено " + to_string(actual.size());
+    for (size_t i = 0; i < expected.size(); i++)
+    {
+        const RoundTripRecord &e = expected[i];
+        const RoundTripRecord &a = actual[i];
+        if (e == a)
+            continue;
+        const char *field = e.year != a.year             ? "год"
+                            : e.course != a.course         ? "курс"
+                            : e.name != a.name             ? "имя"
+                            : e.surname != a.surname       ? "фамилия"
+                            : e.middleName != a.middleName ? "отчество"
+                                                           : "предметы и оценки";
+        return string("расходится поле «") + field + "» у записи " + e.surname + " " + e.name;
+    }
+    return string();
+}
+
+struct QuietOutput
+{
+    streambuf *saved;
+
+    QuietOutput() : saved(cout.rdbuf(nullptr)) {}
+    ~QuietOutput() { cout.rdbuf(saved); }
+};
+
+vector<RoundTripResult> runRoundTrip(const vector<RoundTripCodec> &codecs,
+                                     void (*stage)(const vector<RoundTripRecord> &records), const vector<size_t> &tiers,
+                                     uint64_t seed)
+{
+    vector<RoundTripResult> results;
+    for (size_t tier : tiers)
+    {
+        vector<RoundTripRecord> expected = generateRoundTripRoster(tier, seed + tier);
+        vector<RoundTripRecord> sorted = expected;
+        sort(sorted.begin(), sorted.end());
+        for (const RoundTripCodec &codec : codecs)
+        {
+            RoundTripResult result = {codec.name, tier, 0, 0, 0, string()};
+            vector<RoundTripRecord> actual;
+            {
+                QuietOutput quiet;
+                stage(expected);
+                auto start = chrono::steady_clock::now();
+                codec.save();
+                auto saved = chrono::steady_clock::now();
+                codec.load(actual);
+                auto loaded = chrono::steady_clock::now();
+                result.saveSeconds = chrono::duration<double>(saved - start).count();
+                result.loadSeconds = chrono::duration<double>(loaded - saved).count();
+            }
+            error_code ec;
+            result.bytes = filesystem::file_size(codec.path, ec);
+            sort(actual.begin(), actual.end());
+            result.problem = describeMismatch(sorted, actual);
+            results.push_back(move(result));
+        }
+    }
+    return results;
+}
+
+// The repository's own forStudents.bin, rebuilt byte for byte: a legacy-format
+// file whose first subject carries the grade list "3,3,,3".
+static string legacyBinaryFixture()
+{
+    string bytes;
+    auto putInt = [&](int value) { bytes.append((const char *)&value, sizeof(value)); };
+    putInt(1);
+    putInt(2007);
+    putInt(2);
+    for (const char *field : {"A", "B", "C", "дф", "3,3,,3", "гчгчг", "3,4,5", "фйгйгйгйг", "4,4,4"})
+    {
+        putInt(strlen(field));
+        bytes += field;
+    }
+    return bytes;
+}
+
+RoundTripResult runLegacyFixture(const char *path, void (*load)(vector<RoundTripRecord> &records))
+{
+    RoundTripResult result = {"legacy-bin", 1, 0, 0, 0, string()};
+    string bytes = legacyBinaryFixture();
+    {
+        ofstream out(path, ios::binary | ios::trunc);
+        out.write(bytes.data(), bytes.size());
+    }
+    result.bytes = bytes.size();
+
+    SubjectListBuilder builder;
+    builder.add("дф", "3,3,3");
+    builder.add("гчгчг", "3,4,5");
+    builder.add("фйгйгйгйг", "4,4,4");
+    vector<RoundTripRecord> expected = {{2007, 2, "A", "B", "C", string(builder.encode())}};
+    vector<RoundTripRecord> actual;
+    {
+        QuietOutput quiet;
+        auto start = chrono::steady_clock::now();
+        load(actual);
+        result.loadSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+    result.problem = describeMismatch(expected, actual);
+    return result;
+}
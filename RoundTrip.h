@@ -0,0 +1,58 @@
+#ifndef UTP_ROUNDTRIP_H
+#define UTP_ROUNDTRIP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Student.h"
+
+const std::uint64_t ROUND_TRIP_SEED = 20240601;
+const std::size_t ROUND_TRIP_TIERS[] = {1000, 10000, 100000};
+
+// Arena-independent copy of a student, so expected rosters survive the
+// arena resets done by every loader.
+struct RoundTripRecord
+{
+    int year;
+    int course;
+    std::string name;
+    std::string surname;
+    std::string middleName;
+    std::string subjects;
+
+    bool operator<(const RoundTripRecord &other) const;
+    bool operator==(const RoundTripRecord &other) const;
+};
+
+struct RoundTripCodec
+{
+    const char *name;
+    const char *path;
+    void (*save)();
+    void (*load)(std::vector<RoundTripRecord> &records);
+};
+
+struct RoundTripResult
+{
+    std::string format;
+    std::size_t records;
+    std::uint64_t bytes;
+    double saveSeconds;
+    double loadSeconds;
+    std::string problem;
+};
+
+std::vector<RoundTripRecord> generateRoundTripRoster(std::size_t count, std::uint64_t seed);
+RoundTripRecord roundTripRecordOf(const Student &student);
+void fillStudentFrom(const RoundTripRecord &record, Student &student);
+// stage() puts a roster in memory before each timed save, so the figures
+// cover only the codec itself.
+std::vector<RoundTripResult> runRoundTrip(const std::vector<RoundTripCodec> &codecs,
+                                          void (*stage)(const std::vector<RoundTripRecord> &records),
+                                          const std::vector<std::size_t> &tiers, std::uint64_t seed);
+// Loads a fixed legacy binary file with known quirks; there is no save step, so
+// saveSeconds stays zero.
+RoundTripResult runLegacyFixture(const char *path, void (*load)(std::vector<RoundTripRecord> &records));
+
+#endif
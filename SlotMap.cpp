@@ -0,0 +1,97 @@
+#include "SlotMap.h"
+#include "Memory.h"
+
+#include <vector>
+
+using namespace std;
+
+struct StudentSlot
+{
+    int position;
+    uint32_t generation;
+    int nextFree;
+};
+
+static vector<StudentSlot> slots;
+static int freeHead = -1;
+
+static uint32_t slotOf(uint64_t id)
+{
+    return (uint32_t)(id & 0xFFFFFFFFu) - 1;
+}
+
+static uint32_t generationOf(uint64_t id)
+{
+    return (uint32_t)(id >> 32);
+}
+
+static uint64_t makeId(uint32_t slot, uint32_t generation)
+{
+    return ((uint64_t)generation << 32) | (uint64_t)(slot + 1);
+}
+
+static StudentSlot *findSlot(uint64_t id)
+{
+    if (id == INVALID_STUDENT_ID)
+        return nullptr;
+    uint32_t slot = slotOf(id);
+    if (slot >= slots.size())
+        return nullptr;
+    StudentSlot &entry = slots[slot];
+    if (entry.position < 0 || entry.generation != generationOf(id))
+        return nullptr;
+    return &entry;
+}
+
+void resetStudentIds()
+{
+    slots.clear();
+    freeHead = -1;
+}
+
+uint64_t allocateStudentId(int position)
+{
+    uint32_t slot;
+    if (freeHead >= 0)
+    {
+        slot = freeHead;
+        freeHead = slots[slot].nextFree;
+    }
+    else
+    {
+        slot = slots.size();
+        slots.push_back({-1, 0, -1});
+    }
+    slots[slot].position = position;
+    slots[slot].nextFree = -1;
+    return makeId(slot, slots[slot].generation);
+}
+
+void releaseStudentId(uint64_t id)
+{
+    StudentSlot *entry = findSlot(id);
+    if (!entry)
+        return;
+    entry->position = -1;
+    entry->generation++;
+    entry->nextFree = freeHead;
+    freeHead = slotOf(id);
+}
+
+void moveStudentId(uint64_t id, int position)
+{
+    StudentSlot *entry = findSlot(id);
+    if (entry)
+        entry->position = position;
+}
+
+int positionOfStudentId(uint64_t id)
+{
+    StudentSlot *entry = findSlot(id);
+    return entry ? entry->position : -1;
+}
+
+size_t studentIdBytes()
+{
+    return vectorBytes(slots);
+}
@@ -0,0 +1,16 @@
+#ifndef UTP_SLOTMAP_H
+#define UTP_SLOTMAP_H
+
+#include <cstddef>
+#include <cstdint>
+
+const uint64_t INVALID_STUDENT_ID = 0;
+
+void resetStudentIds();
+uint64_t allocateStudentId(int position);
+void releaseStudentId(uint64_t id);
+void moveStudentId(uint64_t id, int position);
+int positionOfStudentId(uint64_t id);
+size_t studentIdBytes();
+
+#endif
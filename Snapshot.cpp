@@ -0,0 +1,283 @@
+#include "Snapshot.h"
+#include "SlotMap.h"
+
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <vector>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+bool readWholeFile(const string &path, vector<char> &buffer);
+
+const char SNAPSHOT_MAGIC[8] = {'U', 'T', 'P', 'S', 'N', 'P', '3', '\0'};
+const int SNAPSHOT_FIELDS = 4;
+const int SNAPSHOT_NAME_FIELDS = 3;
+const size_t SNAPSHOT_PATH_BYTES = 256;
+
+struct SnapshotHeader
+{
+    char magic[8];
+    int32_t binary;
+    int32_t recordSize;
+    int64_t sourceSize;
+    int64_t sourceTime;
+    int64_t count;
+    int64_t heapSize;
+    char sourcePath[SNAPSHOT_PATH_BYTES];
+};
+
+struct SnapshotField
+{
+    uint32_t offset;
+    uint32_t length;
+};
+
+// Names are stored ahead of all subject lists. Subject blocks get their full
+// check, grade bytes included, when the snapshot is written; on read only
+// their end-offset arrays are checked, so a torn file cannot send subject(j)
+// or grades(j) past the block.
+struct SnapshotRecord
+{
+    int32_t year;
+    int32_t course;
+    int32_t slot;
+    SnapshotField fields[SNAPSHOT_FIELDS];
+};
+
+static_assert(sizeof(SnapshotHeader) % alignof(SnapshotRecord) == 0, "records must stay aligned in the mapping");
+
+static const SnapshotRecord *mappedRecords = nullptr;
+static const char *mappedHeap = nullptr;
+static uint64_t mappedHeapSize = 0;
+static int64_t mappedCount = 0;
+
+static int64_t sourceTimeOf(const string &path)
+{
+    error_code ec;
+    auto t = filesystem::last_write_time(path, ec);
+    if (ec)
+        return 0;
+    return (int64_t)t.time_since_epoch().count();
+}
+
+static void studentFields(const Student &student, string_view values[SNAPSHOT_FIELDS])
+{
+    values[0] = student.name;
+    values[1] = student.surname;
+    values[2] = student.middleName;
+    values[3] = student.subjects.encoded();
+}
+
+bool writeSnapshot(const string &path, const SnapshotSource &source, const Student *arr, int count,
+                   const vector<int> &slots)
+{
+    error_code ec;
+    SnapshotHeader header = {};
+    if (source.path.size() >= SNAPSHOT_PATH_BYTES)
+        return false;
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    memcpy(header.sourcePath, source.path.data(), source.path.size());
+    header.binary = source.binary ? 1 : 0;
+    header.recordSize = sizeof(SnapshotRecord);
+    header.sourceSize = (int64_t)filesystem::file_size(source.path, ec);
+    header.sourceTime = sourceTimeOf(source.path);
+    if (ec)
+        return false;
+
+    vector<SnapshotRecord> records;
+    records.reserve(count);
+    for (int i = 0; i < count; i++)
+    {
+        if (arr[i].id == INVALID_STUDENT_ID)
+            continue;
+        SubjectList checked;
+        if (!SubjectList::view(arr[i].subjects.encoded(), checked))
+            return false;
+        SnapshotRecord record;
+        record.year = arr[i].year;
+        record.course = arr[i].course;
+        record.slot = slots.empty() ? -1 : slots[i];
+        records.push_back(record);
+    }
+
+    uint64_t heapSize = 0;
+    string_view values[SNAPSHOT_FIELDS];
+    for (int pass = 0; pass < 2; pass++)
+    {
+        size_t r = 0;
+        for (int i = 0; i < count; i++)
+        {
+            if (arr[i].id == INVALID_STUDENT_ID)
+                continue;
+            studentFields(arr[i], values);
+            for (int f = pass ? SNAPSHOT_NAME_FIELDS : 0; f < (pass ? SNAPSHOT_FIELDS : SNAPSHOT_NAME_FIELDS); f++)
+            {
+                if (heapSize + values[f].size() > UINT32_MAX)
+                    return false;
+                records[r].fields[f] = {(uint32_t)heapSize, (uint32_t)values[f].size()};
+                heapSize += values[f].size();
+            }
+            r++;
+        }
+    }
+    header.count = records.size();
+    header.heapSize = heapSize;
+
+    string tmpPath = path + ".tmp";
+    ofstream out(tmpPath, ios::binary | ios::trunc);
+    if (!out)
+        return false;
+    out.write((char *)&header, sizeof(header));
+    out.write((char *)records.data(), records.size() * sizeof(SnapshotRecord));
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            if (arr[i].id == INVALID_STUDENT_ID)
+                continue;
+            studentFields(arr[i], values);
+            for (int f = pass ? SNAPSHOT_NAME_FIELDS : 0; f < (pass ? SNAPSHOT_FIELDS : SNAPSHOT_NAME_FIELDS); f++)
+                out.write(values[f].data(), values[f].size());
+        }
+    }
+    out.close();
+    if (!out)
+    {
+        filesystem::remove(tmpPath, ec);
+        return false;
+    }
+    filesystem::rename(tmpPath, path, ec);
+    return !ec;
+}
+
+static bool validHeader(const SnapshotHeader &header)
+{
+    return memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) == 0 &&
+           header.recordSize == (int32_t)sizeof(SnapshotRecord) &&
+           memchr(header.sourcePath, '\0', SNAPSHOT_PATH_BYTES) != nullptr;
+}
+
+static bool headerFresh(const SnapshotHeader &header)
+{
+    error_code ec;
+    int64_t size = (int64_t)filesystem::file_size(header.sourcePath, ec);
+    return !ec && size == header.sourceSize && sourceTimeOf(header.sourcePath) == header.sourceTime;
+}
+
+bool readSnapshotSource(const string &path, SnapshotSource &source)
+{
+    ifstream in(path, ios::binary);
+    SnapshotHeader header;
+    if (!in.read((char *)&header, sizeof(header)) || !validHeader(header))
+        return false;
+    source.path = header.sourcePath;
+    source.binary = header.binary != 0;
+    return true;
+}
+
+static shared_ptr<const char> mapWholeFile(const string &path, size_t &size)
+{
+#ifndef _WIN32
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return nullptr;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        return nullptr;
+    }
+    size = st.st_size;
+    void *base = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return nullptr;
+    return shared_ptr<const char>((const char *)base, [size](const char *p) { munmap((void *)p, size); });
+#else
+    auto buffer = make_shared<vector<char>>();
+    if (!readWholeFile(path, *buffer) || buffer->empty())
+        return nullptr;
+    size = buffer->size();
+    return shared_ptr<const char>(buffer, buffer->data());
+#endif
+}
+
+bool mapSnapshot(const string &path, SnapshotSource &source, int &count)
+{
+    size_t size = 0;
+    shared_ptr<const char> region = mapWholeFile(path, size);
+    if (!region || size < sizeof(SnapshotHeader))
+        return false;
+
+    SnapshotHeader header;
+    memcpy(&header, region.get(), sizeof(header));
+    if (!validHeader(header) || !headerFresh(header) || header.count < 0 || header.count > INT_MAX ||
+        header.heapSize < 0)
+        return false;
+    uint64_t body = size - sizeof(SnapshotHeader);
+    if ((uint64_t)header.count > body / sizeof(SnapshotRecord) ||
+        body - header.count * sizeof(SnapshotRecord) != (uint64_t)header.heapSize)
+        return false;
+
+    const char *base = adoptMappedRegion(move(region), size);
+    mappedRecords = (const SnapshotRecord *)(base + sizeof(SnapshotHeader));
+    mappedHeap = (const char *)(mappedRecords + header.count);
+    mappedHeapSize = header.heapSize;
+    mappedCount = header.count;
+    source.path = header.sourcePath;
+    source.binary = header.binary != 0;
+    count = (int)header.count;
+    return true;
+}
+
+static bool decodeSnapshotRecord(const SnapshotRecord &record, Student &student)
+{
+    string_view values[SNAPSHOT_FIELDS];
+    for (int f = 0; f < SNAPSHOT_FIELDS; f++)
+    {
+        const SnapshotField &field = record.fields[f];
+        if ((uint64_t)field.offset + field.length > mappedHeapSize)
+            return false;
+        values[f] = string_view(mappedHeap + field.offset, field.length);
+    }
+
+    student.year = record.year;
+    student.course = record.course;
+    student.name = values[0];
+    student.surname = values[1];
+    student.middleName = values[2];
+    return SubjectList::viewLayout(values[3], student.subjects);
+}
+
+bool readSnapshotRecords(Student *arr, int count, vector<int> &slots)
+{
+    if (count > mappedCount)
+        return false;
+    slots.resize(count);
+    for (int i = 0; i < count; i++)
+    {
+        if (!decodeSnapshotRecord(mappedRecords[i], arr[i]))
+            return false;
+        slots[i] = mappedRecords[i].slot;
+    }
+    return true;
+}
+
+// A damaged record comes back empty, so a page being served still shows its other rows.
+bool readSnapshotRecord(int index, Student &student)
+{
+    if (index >= 0 && index < mappedCount && decodeSnapshotRecord(mappedRecords[index], student))
+        return true;
+    student = Student();
+    return false;
+}
@@ -0,0 +1,21 @@
+#ifndef UTP_SNAPSHOT_H
+#define UTP_SNAPSHOT_H
+
+#include <string>
+#include <vector>
+#include "Student.h"
+
+struct SnapshotSource
+{
+    std::string path;
+    bool binary;
+};
+
+bool writeSnapshot(const std::string &path, const SnapshotSource &source, const Student *arr, int count,
+                   const std::vector<int> &slots);
+bool readSnapshotSource(const std::string &path, SnapshotSource &source);
+bool mapSnapshot(const std::string &path, SnapshotSource &source, int &count);
+bool readSnapshotRecords(Student *arr, int count, std::vector<int> &slots);
+bool readSnapshotRecord(int index, Student &student);
+
+#endif
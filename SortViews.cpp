@@ -0,0 +1,306 @@
+#include "SortViews.h"
+#include "Memory.h"
+#include "Metrics.h"
+#include "SurnameIndex.h"
+#include "SlotMap.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+
+using namespace std;
+
+double calcAverageGrade(const Student &student);
+
+struct SortView
+{
+    SortSpec spec;
+    size_t width = 0;
+    vector<unsigned char> keys;
+    vector<int> order;
+};
+
+struct SortFieldName
+{
+    const char *english;
+    const char *russian;
+    const char *alias;
+};
+
+static const SortFieldName FIELD_NAMES[SORT_FIELD_COUNT] = {
+    {"", "", ""},
+    {"year", "год", ""},
+    {"course", "курс", ""},
+    {"name", "имя", ""},
+    {"surname", "фамилия", ""},
+    {"middlename", "отчество", ""},
+    {"avg", "балл", "average"}};
+
+static map<string, SortView> views;
+
+static size_t fieldWidth(SortField field)
+{
+    switch (field)
+    {
+    case SORT_YEAR:
+    case SORT_COURSE:
+        return sizeof(uint32_t);
+    case SORT_AVERAGE:
+        return sizeof(uint64_t);
+    default:
+        return SORT_TEXT_KEY_BYTES;
+    }
+}
+
+static void putBigEndian(unsigned char *out, uint64_t value, size_t bytes)
+{
+    for (size_t i = 0; i < bytes; i++)
+        out[i] = (unsigned char)(value >> (8 * (bytes - 1 - i)));
+}
+
+static void encodeText(unsigned char *out, string_view text)
+{
+    string folded = foldCase(text);
+    size_t n = min(folded.size(), SORT_TEXT_KEY_BYTES);
+    memcpy(out, folded.data(), n);
+    memset(out + n, 0, SORT_TEXT_KEY_BYTES - n);
+}
+
+static void encodePart(unsigned char *out, SortKeyPart part, const Student &student)
+{
+    switch (part.field)
+    {
+    case SORT_YEAR:
+        putBigEndian(out, (uint32_t)student.year ^ 0x80000000u, sizeof(uint32_t));
+        break;
+    case SORT_COURSE:
+        putBigEndian(out, (uint32_t)student.course ^ 0x80000000u, sizeof(uint32_t));
+        break;
+    case SORT_AVERAGE:
+    {
+        double average = calcAverageGrade(student);
+        uint64_t bits;
+        memcpy(&bits, &average, sizeof(bits));
+        bits = (bits >> 63) ? ~bits : bits | (1ULL << 63);
+        putBigEndian(out, bits, sizeof(uint64_t));
+        break;
+    }
+    case SORT_NAME:
+        encodeText(out, student.name);
+        break;
+    case SORT_SURNAME:
+        encodeText(out, student.surname);
+        break;
+    default:
+        encodeText(out, student.middleName);
+        break;
+    }
+    if (!part.ascending)
+    {
+        for (size_t i = 0; i < fieldWidth(part.field); i++)
+            out[i] = ~out[i];
+    }
+}
+
+static void encodeKey(SortView &view, int index, const Student &student)
+{
+    if ((size_t)(index + 1) * view.width > view.keys.size())
+        view.keys.resize((size_t)(index + 1) * view.width);
+    unsigned char *out = &view.keys[(size_t)index * view.width];
+    for (const SortKeyPart &part : view.spec)
+    {
+        encodePart(out, part, student);
+        out += fieldWidth(part.field);
+    }
+    putBigEndian(out, (uint32_t)index, sizeof(uint32_t));
+}
+
+static bool keyBefore(const SortView &view, int a, int b)
+{
+    return memcmp(&view.keys[(size_t)a * view.width], &view.keys[(size_t)b * view.width], view.width) < 0;
+}
+
+static bool parseField(const string &word, SortField &field)
+{
+    string folded = foldCase(word);
+    for (int f = SORT_YEAR; f < SORT_FIELD_COUNT; f++)
+    {
+        if (folded == FIELD_NAMES[f].english || folded == FIELD_NAMES[f].russian ||
+            (*FIELD_NAMES[f].alias && folded == FIELD_NAMES[f].alias))
+        {
+            field = (SortField)f;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parseSortSpec(const string &text, SortSpec &spec, string &error)
+{
+    spec.clear();
+    size_t start = 0;
+    while (start <= text.size())
+    {
+        size_t end = text.find(',', start);
+        if (end == string::npos)
+            end = text.size();
+
+        vector<string> words;
+        size_t pos = start;
+        while (pos < end)
+        {
+            size_t wordEnd = text.find_first_of(" \t", pos);
+            if (wordEnd == string::npos || wordEnd > end)
+                wordEnd = end;
+            if (wordEnd > pos)
+                words.push_back(text.substr(pos, wordEnd - pos));
+            pos = wordEnd + 1;
+        }
+
+        if (words.empty() || words.size() > 2)
+        {
+            error = "ожидалось <поле> [asc|desc] через запятую";
+            return false;
+        }
+        SortKeyPart part = {SORT_NONE, true};
+        if (!parseField(words[0], part.field))
+        {
+            error = "неизвестное поле \"" + words[0] + "\"";
+            return false;
+        }
+        if (words.size() == 2)
+        {
+            string direction = foldCase(words[1]);
+            if (direction == "desc" || direction == "убыв")
+                part.ascending = false;
+            else if (direction != "asc" && direction != "возр")
+            {
+                error = "неизвестный порядок \"" + words[1] + "\"";
+                return false;
+            }
+        }
+        spec.push_back(part);
+        start = end + 1;
+    }
+    return true;
+}
+
+string sortSpecName(const SortSpec &spec)
+{
+    if (spec.empty())
+        return "порядок файла";
+    string name;
+    for (const SortKeyPart &part : spec)
+    {
+        if (!name.empty())
+            name += ", ";
+        name += FIELD_NAMES[part.field].english;
+        name += part.ascending ? " asc" : " desc";
+    }
+    return name;
+}
+
+// Every sort goes through here: menu 8 and exports build cached views, the
+// load-time year sort a one-off permutation.
+static void buildView(SortView &view, const SortSpec &spec, const Student *arr, int count)
+{
+    MetricTimer timer(METRIC_SORT);
+    metricAddRecords(METRIC_SORT, count);
+    view.spec = spec;
+    view.width = sizeof(uint32_t);
+    for (const SortKeyPart &part : spec)
+        view.width += fieldWidth(part.field);
+    view.keys.assign((size_t)count * view.width, 0);
+    parallelFor(0, count, PARALLEL_FOR_GRAIN, [&](size_t from, size_t to) {
+        for (size_t i = from; i < to; i++)
+            encodeKey(view, i, arr[i]);
+    });
+
+    view.order.clear();
+    for (int i = 0; i < count; i++)
+    {
+        if (arr[i].id != INVALID_STUDENT_ID)
+            view.order.push_back(i);
+    }
+    if (!spec.empty())
+    {
+        parallelSort(view.order.data(), view.order.data() + view.order.size(), [&view](int a, int b) {
+            return keyBefore(view, a, b);
+        });
+    }
+}
+
+const vector<int> &sortView(const SortSpec &spec, const Student *arr, int count)
+{
+    string name = sortSpecName(spec);
+    auto found = views.find(name);
+    if (found != views.end())
+        return found->second.order;
+
+    SortView &view = views[name];
+    buildView(view, spec, arr, count);
+    return view.order;
+}
+
+vector<int> sortPermutation(const SortSpec &spec, const Student *arr, int count)
+{
+    SortView view;
+    buildView(view, spec, arr, count);
+    return move(view.order);
+}
+
+bool sortViewBuilt(const SortSpec &spec)
+{
+    return views.count(sortSpecName(spec)) > 0;
+}
+
+void resetSortViews()
+{
+    views.clear();
+}
+
+static vector<int>::iterator positionIn(SortView &view, int index)
+{
+    return lower_bound(view.order.begin(), view.order.end(), index, [&](int a, int b) {
+        return keyBefore(view, a, b);
+    });
+}
+
+void sortViewsInsert(int index, const Student *arr)
+{
+    for (auto &entry : views)
+    {
+        SortView &view = entry.second;
+        encodeKey(view, index, arr[index]);
+        view.order.insert(positionIn(view, index), index);
+    }
+}
+
+void sortViewsUpdate(int index, const Student *arr)
+{
+    sortViewsErase(index);
+    sortViewsInsert(index, arr);
+}
+
+void sortViewsErase(int index)
+{
+    for (auto &entry : views)
+    {
+        SortView &view = entry.second;
+        if ((size_t)(index + 1) * view.width > view.keys.size())
+            continue;
+        auto it = positionIn(view, index);
+        if (it != view.order.end() && *it == index)
+            view.order.erase(it);
+    }
+}
+
+size_t sortViewBytes()
+{
+    size_t bytes = nodeTableBytes(views);
+    for (const auto &view : views)
+        bytes += stringBytes(view.first) + vectorBytes(view.second.spec) + vectorBytes(view.second.keys) +
+                 vectorBytes(view.second.order);
+    return bytes;
+}
@@ -0,0 +1,42 @@
+#ifndef UTP_SORTVIEWS_H
+#define UTP_SORTVIEWS_H
+
+#include <string>
+#include <vector>
+#include "Student.h"
+
+enum SortField
+{
+    SORT_NONE,
+    SORT_YEAR,
+    SORT_COURSE,
+    SORT_NAME,
+    SORT_SURNAME,
+    SORT_MIDDLE_NAME,
+    SORT_AVERAGE,
+    SORT_FIELD_COUNT
+};
+
+const size_t SORT_TEXT_KEY_BYTES = 32;
+
+struct SortKeyPart
+{
+    SortField field;
+    bool ascending;
+};
+
+typedef std::vector<SortKeyPart> SortSpec;
+
+bool parseSortSpec(const std::string &text, SortSpec &spec, std::string &error);
+std::string sortSpecName(const SortSpec &spec);
+
+const std::vector<int> &sortView(const SortSpec &spec, const Student *arr, int count);
+std::vector<int> sortPermutation(const SortSpec &spec, const Student *arr, int count);
+bool sortViewBuilt(const SortSpec &spec);
+void resetSortViews();
+void sortViewsInsert(int index, const Student *arr);
+void sortViewsUpdate(int index, const Student *arr);
+void sortViewsErase(int index);
+size_t sortViewBytes();
+
+#endif
@@ -1,6 +1,9 @@
-
 #include "Student.h"
 
 void updateName(Student& student, std::string newName) {
      student.name = newName;
-}
\ No newline at end of file
+}
+
+void ownStudentFields(Student& student) {
+     student.subjects = SubjectList::copy(student.subjects.encoded());
+}
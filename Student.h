@@ -1,21 +1,35 @@
 #ifndef UTP_STUDENT_H
 #define UTP_STUDENT_H
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
+#include "Arena.h"
+#include "InlineString.h"
+#include "SubjectList.h"
 
 struct Student {
-    std::string name;
-    std::string surname;
-    std::string middleName;
+    std::uint64_t id;
+    InlineName name;
+    InlineName surname;
+    InlineName middleName;
     int year;
     int course;
-    std::string subjects[3];
-    std::string grades[3];
+    SubjectList subjects;
 
     Student()
-        : name(""), surname(""), middleName(""), year(0), course(0) {}
+        : id(0), year(0), course(0) {}
 };
 
+// A run of consecutive records, for code that reads the live array and
+// pinned roster versions alike.
+struct StudentSpan
+{
+    const Student *records;
+    std::size_t size;
+};
 
-#endif
+void ownStudentFields(Student &student);
 
+
+#endif
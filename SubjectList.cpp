@@ -0,0 +1,259 @@
+#include "SubjectList.h"
+#include "Arena.h"
+
+#include <cstring>
+
+using namespace std;
+
+static uint16_t readWord(const char *p)
+{
+    uint16_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+uint16_t SubjectList::word(int i) const
+{
+    return readWord(block + i * sizeof(uint16_t));
+}
+
+int SubjectList::size() const
+{
+    return block ? word(0) : 0;
+}
+
+string_view SubjectList::subject(int i) const
+{
+    int n = size();
+    const char *names = block + (1 + 2 * n) * sizeof(uint16_t);
+    uint16_t begin = i == 0 ? 0 : word(i);
+    return string_view(names + begin, word(1 + i) - begin);
+}
+
+GradeSpan SubjectList::grades(int i) const
+{
+    int n = size();
+    const char *grades = block + (1 + 2 * n) * sizeof(uint16_t) + word(n);
+    uint16_t begin = i == 0 ? 0 : word(n + i);
+    return {(const uint8_t *)grades + begin, (size_t)(word(1 + n + i) - begin)};
+}
+
+string SubjectList::gradesText(int i) const
+{
+    GradeSpan span = grades(i);
+    string text;
+    for (size_t g = 0; g < span.size; g++)
+    {
+        if (g != 0)
+            text.push_back(',');
+        text.push_back('0' + span.data[g]);
+    }
+    return text;
+}
+
+string_view SubjectList::encoded() const
+{
+    int n = size();
+    if (n == 0)
+        return string_view();
+    return string_view(block, (1 + 2 * n) * sizeof(uint16_t) + word(n) + word(2 * n));
+}
+
+bool SubjectList::viewLayout(string_view encoded, SubjectList &list)
+{
+    list.block = nullptr;
+    if (encoded.empty())
+        return true;
+    if (encoded.size() < sizeof(uint16_t))
+        return false;
+    int n = readWord(encoded.data());
+    size_t header = (1 + 2 * n) * sizeof(uint16_t);
+    if (n == 0 || n > MAX_SUBJECTS || encoded.size() < header)
+        return false;
+
+    uint16_t previous = 0;
+    for (int i = 0; i < 2 * n; i++)
+    {
+        uint16_t end = readWord(encoded.data() + (1 + i) * sizeof(uint16_t));
+        if (i == n)
+            previous = 0;
+        if (end < previous)
+            return false;
+        previous = end;
+    }
+    uint16_t namesSize = readWord(encoded.data() + n * sizeof(uint16_t));
+    uint16_t gradesSize = readWord(encoded.data() + 2 * n * sizeof(uint16_t));
+    if (encoded.size() != header + namesSize + gradesSize)
+        return false;
+    list.block = encoded.data();
+    return true;
+}
+
+bool SubjectList::view(string_view encoded, SubjectList &list)
+{
+    if (!viewLayout(encoded, list))
+        return false;
+    if (encoded.empty())
+        return true;
+    for (size_t g = encoded.size() - list.word(2 * list.size()); g < encoded.size(); g++)
+    {
+        if (encoded[g] < 1 || encoded[g] > 5)
+        {
+            list.block = nullptr;
+            return false;
+        }
+    }
+    return true;
+}
+
+SubjectList SubjectList::adopt(string_view encoded)
+{
+    SubjectList list;
+    if (!encoded.empty())
+        list.block = encoded.data();
+    return list;
+}
+
+SubjectList SubjectList::copy(string_view encoded)
+{
+    SubjectList list;
+    if (!encoded.empty())
+        list.block = arenaCopy(encoded);
+    return list;
+}
+
+void SubjectListBuilder::clear()
+{
+    count = 0;
+    names.clear();
+    grades.clear();
+}
+
+bool SubjectListBuilder::add(string_view subject, string_view gradesText)
+{
+    size_t before = grades.size();
+    if (count >= MAX_SUBJECTS || !parseGradeList(gradesText, parsed))
+        return false;
+    grades.append(parsed);
+    names.append(subject);
+    if (names.size() > UINT16_MAX || grades.size() > UINT16_MAX)
+    {
+        grades.resize(before);
+        names.resize(names.size() - subject.size());
+        return false;
+    }
+    nameEnds[count] = names.size();
+    gradeEnds[count] = grades.size();
+    count++;
+    return true;
+}
+
+void SubjectListBuilder::add(string_view subject, GradeSpan span)
+{
+    if (count >= MAX_SUBJECTS || names.size() + subject.size() > UINT16_MAX || grades.size() + span.size > UINT16_MAX)
+        return;
+    names.append(subject);
+    grades.append((const char *)span.data, span.size);
+    nameEnds[count] = names.size();
+    gradeEnds[count] = grades.size();
+    count++;
+}
+
+string_view SubjectListBuilder::encode()
+{
+    encoded.clear();
+    if (count == 0)
+        return encoded;
+    uint16_t n = count;
+    encoded.append((const char *)&n, sizeof(n));
+    encoded.append((const char *)nameEnds, count * sizeof(uint16_t));
+    encoded.append((const char *)gradeEnds, count * sizeof(uint16_t));
+    encoded.append(names);
+    encoded.append(grades);
+    return encoded;
+}
+
+SubjectList SubjectListBuilder::build()
+{
+    return SubjectList::copy(encode());
+}
+
+bool parseGradeList(string_view text, string &grades)
+{
+    grades.clear();
+    size_t i = 0;
+    while (true)
+    {
+        if (i >= text.size() || text[i] < '1' || text[i] > '5')
+            return false;
+        grades.push_back(text[i] - '0');
+        i++;
+        if (i == text.size())
+            return (int)grades.size() <= MAX_GRADES_PER_SUBJECT;
+        if (text[i] != ',')
+            return false;
+        i++;
+    }
+}
+
+string describeSubjects(const SubjectList &subjects)
+{
+    string text;
+    for (int i = 0; i < subjects.size(); i++)
+    {
+        if (i != 0)
+            text += "; ";
+        text += subjects.subject(i);
+        text += ": ";
+        text += subjects.gradesText(i);
+    }
+    return text;
+}
+
+// Legacy files predate grade checks on input, so lists such as "3,,3" occur;
+// the empty tokens carry no grade and are dropped rather than failing the record.
+static string_view dropEmptyGrades(string_view grades, string &cleaned)
+{
+    cleaned.clear();
+    size_t start = 0;
+    while (start <= grades.size())
+    {
+        size_t comma = grades.find(',', start);
+        string_view token = grades.substr(start, comma == string_view::npos ? string_view::npos : comma - start);
+        if (!token.empty())
+        {
+            if (!cleaned.empty())
+                cleaned += ',';
+            cleaned.append(token);
+        }
+        if (comma == string_view::npos)
+            break;
+        start = comma + 1;
+    }
+    return cleaned;
+}
+
+bool encodeLegacySubjects(const string_view *pairs, int count, SubjectListBuilder &builder)
+{
+    static string cleaned;
+    builder.clear();
+    for (int j = 0; j < count; j++)
+    {
+        string_view subject = pairs[2 * j];
+        string_view grades = pairs[2 * j + 1];
+        if (subject.empty() && grades.empty())
+            continue;
+        if (!builder.add(subject, dropEmptyGrades(grades, cleaned)))
+            return false;
+    }
+    return true;
+}
+
+bool buildLegacySubjects(const string_view *pairs, int count, SubjectList &subjects)
+{
+    static SubjectListBuilder builder;
+    if (!encodeLegacySubjects(pairs, count, builder))
+        return false;
+    subjects = builder.build();
+    return true;
+}
@@ -0,0 +1,72 @@
+#ifndef UTP_SUBJECTLIST_H
+#define UTP_SUBJECTLIST_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+const int MAX_SUBJECTS = 32;
+const int MAX_GRADES_PER_SUBJECT = 32;
+const int LEGACY_BINARY_SUBJECTS = 3;
+
+struct GradeSpan
+{
+    const std::uint8_t *data;
+    std::size_t size;
+};
+
+// One student's subjects in CSR form, stored as a single block in the string arena:
+// u16 count, u16 nameEnd[count], u16 gradeEnd[count], concatenated names, grade bytes (1-5).
+class SubjectList
+{
+public:
+    SubjectList() : block(nullptr) {}
+
+    static bool view(std::string_view encoded, SubjectList &list);
+    // Checks only the count and the end-offset arrays, enough to keep subject(i)
+    // and grades(i) inside the block; the grade bytes themselves are not read.
+    static bool viewLayout(std::string_view encoded, SubjectList &list);
+    // Wraps a block the caller has just encoded, without checking it again.
+    static SubjectList adopt(std::string_view encoded);
+    static SubjectList copy(std::string_view encoded);
+
+    int size() const;
+    bool empty() const { return size() == 0; }
+    std::string_view subject(int i) const;
+    GradeSpan grades(int i) const;
+    std::string gradesText(int i) const;
+    std::string_view encoded() const;
+
+private:
+    std::uint16_t word(int i) const;
+
+    const char *block;
+};
+
+class SubjectListBuilder
+{
+public:
+    void clear();
+    bool add(std::string_view subject, std::string_view gradesText);
+    void add(std::string_view subject, GradeSpan grades);
+    int size() const { return count; }
+    std::string_view encode();
+    SubjectList build();
+
+private:
+    int count = 0;
+    std::string names;
+    std::string grades;
+    std::string parsed;
+    std::uint16_t nameEnds[MAX_SUBJECTS];
+    std::uint16_t gradeEnds[MAX_SUBJECTS];
+    std::string encoded;
+};
+
+bool parseGradeList(std::string_view text, std::string &grades);
+std::string describeSubjects(const SubjectList &subjects);
+bool encodeLegacySubjects(const std::string_view *pairs, int count, SubjectListBuilder &builder);
+bool buildLegacySubjects(const std::string_view *pairs, int count, SubjectList &subjects);
+
+#endif
@@ -0,0 +1,221 @@
+#include "SurnameIndex.h"
+#include "Memory.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+using namespace std;
+
+struct SurnameKey
+{
+    uint32_t offset;
+    uint32_t length;
+    uint32_t surnameLength;
+    int index;
+};
+
+static string keyPool;
+static size_t keyPoolGarbage = 0;
+static vector<SurnameKey> keys;
+
+static void appendUtf8(string &out, unsigned int cp)
+{
+    if (cp < 0x80)
+    {
+        out.push_back(cp);
+    }
+    else if (cp < 0x800)
+    {
+        out.push_back(0xC0 | (cp >> 6));
+        out.push_back(0x80 | (cp & 0x3F));
+    }
+    else if (cp < 0x10000)
+    {
+        out.push_back(0xE0 | (cp >> 12));
+        out.push_back(0x80 | ((cp >> 6) & 0x3F));
+        out.push_back(0x80 | (cp & 0x3F));
+    }
+    else
+    {
+        out.push_back(0xF0 | (cp >> 18));
+        out.push_back(0x80 | ((cp >> 12) & 0x3F));
+        out.push_back(0x80 | ((cp >> 6) & 0x3F));
+        out.push_back(0x80 | (cp & 0x3F));
+    }
+}
+
+string foldCase(string_view s)
+{
+    string out;
+    out.reserve(s.size());
+    for (size_t i = 0; i < s.size();)
+    {
+        unsigned char c = s[i];
+        if (c < 0x80)
+        {
+            out.push_back(c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c);
+            i++;
+            continue;
+        }
+
+        int len = 1;
+        unsigned int cp = c;
+        if ((c & 0xE0) == 0xC0)
+        {
+            len = 2;
+            cp = c & 0x1F;
+        }
+        else if ((c & 0xF0) == 0xE0)
+        {
+            len = 3;
+            cp = c & 0x0F;
+        }
+        else if ((c & 0xF8) == 0xF0)
+        {
+            len = 4;
+            cp = c & 0x07;
+        }
+        if (len == 1 || i + len > s.size())
+        {
+            out.push_back(c);
+            i++;
+            continue;
+        }
+        for (int k = 1; k < len; k++)
+            cp = (cp << 6) | (s[i + k] & 0x3F);
+
+        if (cp >= 0x410 && cp <= 0x42F)
+            cp += 0x20;
+        else if (cp == 0x401 || cp == 0x451)
+            cp = 0x435;
+        appendUtf8(out, cp);
+        i += len;
+    }
+    return out;
+}
+
+static string_view keyText(const SurnameKey &key)
+{
+    return string_view(keyPool.data() + key.offset, key.length);
+}
+
+static bool keyLess(const SurnameKey &a, const SurnameKey &b)
+{
+    int cmp = keyText(a).compare(keyText(b));
+    return cmp != 0 ? cmp < 0 : a.index < b.index;
+}
+
+static SurnameKey makeKey(int index, const Student &student)
+{
+    string surname = foldCase(student.surname);
+    string full = surname + " " + foldCase(student.name);
+    SurnameKey key;
+    key.offset = keyPool.size();
+    key.length = full.size();
+    key.surnameLength = surname.size();
+    key.index = index;
+    keyPool += full;
+    return key;
+}
+
+static void compactKeyPool()
+{
+    string pool;
+    pool.reserve(keyPool.size() - keyPoolGarbage);
+    for (SurnameKey &key : keys)
+    {
+        uint32_t offset = pool.size();
+        pool.append(keyPool, key.offset, key.length);
+        key.offset = offset;
+    }
+    keyPool.swap(pool);
+    keyPoolGarbage = 0;
+}
+
+void rebuildSurnameIndex(const Student *arr, int count)
+{
+    keyPool.clear();
+    keyPoolGarbage = 0;
+    keys.clear();
+    keys.reserve(count);
+    for (int i = 0; i < count; i++)
+        keys.push_back(makeKey(i, arr[i]));
+    sort(keys.begin(), keys.end(), keyLess);
+}
+
+void surnameIndexInsert(int index, const Student &student)
+{
+    SurnameKey key = makeKey(index, student);
+    keys.insert(upper_bound(keys.begin(), keys.end(), key, keyLess), key);
+}
+
+// Finds the entry by the key the record had when it was indexed, so only that
+// one entry moves instead of the whole array being rewritten.
+static void removeKey(int index, const Student &before)
+{
+    string full = foldCase(before.surname) + " " + foldCase(before.name);
+    auto it = lower_bound(keys.begin(), keys.end(), index, [&full](const SurnameKey &key, int position) {
+        int cmp = keyText(key).compare(full);
+        return cmp != 0 ? cmp < 0 : key.index < position;
+    });
+    if (it == keys.end() || it->index != index || keyText(*it) != full)
+        return;
+    keyPoolGarbage += it->length;
+    keys.erase(it);
+    if (keyPoolGarbage > keyPool.size() / 2)
+        compactKeyPool();
+}
+
+void surnameIndexUpdate(int index, const Student &before, const Student &student)
+{
+    removeKey(index, before);
+    surnameIndexInsert(index, student);
+}
+
+void surnameIndexErase(int index, const Student &student)
+{
+    removeKey(index, student);
+}
+
+vector<int> surnamePrefixLookup(const string &query, int limit)
+{
+    string folded = foldCase(query);
+    size_t space = folded.find(' ');
+    string surnamePrefix = folded.substr(0, space);
+    string namePrefix;
+    if (space != string::npos)
+    {
+        size_t start = folded.find_first_not_of(' ', space);
+        if (start != string::npos)
+            namePrefix = folded.substr(start);
+    }
+
+    vector<int> result;
+    if (surnamePrefix.empty())
+        return result;
+
+    auto first = lower_bound(keys.begin(), keys.end(), surnamePrefix, [](const SurnameKey &key, const string &prefix) {
+        return keyText(key) < prefix;
+    });
+    for (auto it = first; it != keys.end() && (int)result.size() < limit; ++it)
+    {
+        string_view text = keyText(*it);
+        if (text.compare(0, surnamePrefix.size(), surnamePrefix) != 0)
+            break;
+        if (!namePrefix.empty())
+        {
+            string_view name = text.substr(it->surnameLength + 1);
+            if (name.compare(0, namePrefix.size(), namePrefix) != 0)
+                continue;
+        }
+        result.push_back(it->index);
+    }
+    return result;
+}
+
+size_t surnameIndexBytes()
+{
+    return keyPool.capacity() + vectorBytes(keys);
+}
@@ -0,0 +1,18 @@
+#ifndef UTP_SURNAMEINDEX_H
+#define UTP_SURNAMEINDEX_H
+
+#include <string>
+#include <vector>
+#include "Student.h"
+
+std::string foldCase(std::string_view s);
+
+void rebuildSurnameIndex(const Student *arr, int count);
+void surnameIndexInsert(int index, const Student &student);
+void surnameIndexUpdate(int index, const Student &before, const Student &student);
+void surnameIndexErase(int index, const Student &student);
+
+std::vector<int> surnamePrefixLookup(const std::string &query, int limit);
+size_t surnameIndexBytes();
+
+#endif
@@ -0,0 +1,136 @@
+#include "ThreadPool.h"
+
+#include <cstdlib>
+
+using namespace std;
+
+static thread_local int currentWorker = -1;
+
+ThreadPool::ThreadPool(unsigned threads) : queued(0), nextQueue(0), stopping(false)
+{
+    for (unsigned i = 0; i <= threads; i++)
+        queues.emplace_back(new Queue());
+    for (unsigned i = 1; i <= threads; i++)
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        lock_guard<mutex> guard(sleepLock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (thread &worker : workers)
+        worker.join();
+}
+
+void ThreadPool::submit(TaskLatch &latch, function<void()> task)
+{
+    unsigned target = currentWorker >= 0 ? currentWorker : nextQueue++ % queues.size();
+    latch.pending++;
+    {
+        lock_guard<mutex> guard(sleepLock);
+        queued++;
+    }
+    {
+        lock_guard<mutex> guard(queues[target]->lock);
+        queues[target]->tasks.push_back({move(task), &latch});
+    }
+    wake.notify_one();
+}
+
+bool ThreadPool::runOne(unsigned self)
+{
+    Task task = {nullptr, nullptr};
+    {
+        Queue &own = *queues[self];
+        lock_guard<mutex> guard(own.lock);
+        if (!own.tasks.empty())
+        {
+            task = move(own.tasks.back());
+            own.tasks.pop_back();
+            queued--;
+        }
+    }
+    for (size_t i = 1; !task.run && i < queues.size(); i++)
+    {
+        Queue &victim = *queues[(self + i) % queues.size()];
+        lock_guard<mutex> guard(victim.lock);
+        if (!victim.tasks.empty())
+        {
+            task = move(victim.tasks.front());
+            victim.tasks.pop_front();
+            queued--;
+        }
+    }
+    if (!task.run)
+        return false;
+
+    task.run();
+    // The waiter may return and free the latch as soon as it reads zero.
+    if (--task.latch->pending == 0)
+    {
+        lock_guard<mutex> guard(sleepLock);
+        idle.notify_all();
+    }
+    return true;
+}
+
+void ThreadPool::workerLoop(unsigned self)
+{
+    currentWorker = self;
+    while (true)
+    {
+        if (runOne(self))
+            continue;
+        unique_lock<mutex> guard(sleepLock);
+        wake.wait(guard, [this] { return stopping || queued > 0; });
+        if (stopping)
+            return;
+    }
+}
+
+// Helps with queued tasks, its own or not, while the latch is open.
+void ThreadPool::wait(TaskLatch &latch)
+{
+    while (latch.pending > 0)
+    {
+        if (runOne(0))
+            continue;
+        unique_lock<mutex> guard(sleepLock);
+        idle.wait(guard, [&latch] { return latch.pending == 0; });
+    }
+}
+
+static unsigned configuredThreads()
+{
+    const char *env = getenv("UTP_THREADS");
+    int threads = env ? atoi(env) : 0;
+    if (threads <= 0)
+        threads = thread::hardware_concurrency();
+    return max(1, threads);
+}
+
+ThreadPool &sharedThreadPool()
+{
+    static ThreadPool pool(configuredThreads() - 1);
+    return pool;
+}
+
+void parallelFor(size_t begin, size_t end, size_t grain, const function<void(size_t, size_t)> &body)
+{
+    ThreadPool &pool = sharedThreadPool();
+    if (end - begin <= grain || pool.concurrency() < 2)
+    {
+        body(begin, end);
+        return;
+    }
+    TaskLatch latch;
+    for (size_t from = begin; from < end; from += grain)
+    {
+        size_t to = min(end, from + grain);
+        pool.submit(latch, [&body, from, to] { body(from, to); });
+    }
+    pool.wait(latch);
+}
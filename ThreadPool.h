@@ -0,0 +1,131 @@
+#ifndef UTP_THREADPOOL_H
+#define UTP_THREADPOOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+const size_t PARALLEL_SORT_THRESHOLD = 1 << 15;
+const size_t PARALLEL_FOR_GRAIN = 1 << 12;
+
+// Unfinished tasks of one parallel call. Several threads may use the pool
+// at once; each waits on its own latch, not for everyone's work.
+struct TaskLatch
+{
+    std::atomic<size_t> pending{0};
+};
+
+class ThreadPool
+{
+public:
+    explicit ThreadPool(unsigned threads);
+    ~ThreadPool();
+
+    void submit(TaskLatch &latch, std::function<void()> task);
+    void wait(TaskLatch &latch);
+    unsigned concurrency() const { return workers.size() + 1; }
+
+private:
+    struct Task
+    {
+        std::function<void()> run;
+        TaskLatch *latch;
+    };
+
+    struct Queue
+    {
+        std::mutex lock;
+        std::deque<Task> tasks;
+    };
+
+    bool runOne(unsigned self);
+    void workerLoop(unsigned self);
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> queued;
+    std::atomic<unsigned> nextQueue;
+    std::mutex sleepLock;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    bool stopping;
+};
+
+ThreadPool &sharedThreadPool();
+
+void parallelFor(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)> &body);
+
+template <class T, class Compare>
+void parallelSort(T *first, T *last, Compare comp)
+{
+    size_t n = last - first;
+    ThreadPool &pool = sharedThreadPool();
+    size_t workers = pool.concurrency();
+    if (n < PARALLEL_SORT_THRESHOLD || workers < 2)
+    {
+        std::sort(first, last, comp);
+        return;
+    }
+
+    size_t runs = workers * 4;
+    TaskLatch latch;
+    std::vector<size_t> bounds(runs + 1);
+    for (size_t r = 0; r <= runs; r++)
+        bounds[r] = n * r / runs;
+    for (size_t r = 0; r < runs; r++)
+    {
+        T *from = first + bounds[r];
+        T *to = first + bounds[r + 1];
+        pool.submit(latch, [from, to, comp] { std::sort(from, to, comp); });
+    }
+    pool.wait(latch);
+
+    std::vector<T> buffer(n);
+    T *src = first;
+    T *dst = buffer.data();
+    size_t piece = std::max<size_t>(PARALLEL_FOR_GRAIN, n / (workers * 4));
+    while (bounds.size() > 2)
+    {
+        std::vector<size_t> merged;
+        for (size_t r = 0; r + 1 < bounds.size(); r += 2)
+        {
+            merged.push_back(bounds[r]);
+            if (r + 2 >= bounds.size())
+            {
+                std::copy(src + bounds[r], src + bounds[r + 1], dst + bounds[r]);
+                continue;
+            }
+            T *a = src + bounds[r];
+            T *aEnd = src + bounds[r + 1];
+            T *b = aEnd;
+            T *bEnd = src + bounds[r + 2];
+            T *out = dst + bounds[r];
+            while (a < aEnd)
+            {
+                T *aCut = a + std::min<size_t>(piece, aEnd - a);
+                T *bCut = aCut == aEnd ? bEnd : std::lower_bound(b, bEnd, *aCut, comp);
+                pool.submit(latch, [a, aCut, b, bCut, out, comp] { std::merge(a, aCut, b, bCut, out, comp); });
+                out += (aCut - a) + (bCut - b);
+                a = aCut;
+                b = bCut;
+            }
+            if (b < bEnd)
+                std::copy(b, bEnd, out);
+        }
+        merged.push_back(n);
+        pool.wait(latch);
+        bounds.swap(merged);
+        std::swap(src, dst);
+    }
+    if (src != first)
+        std::copy(src, src + n, first);
+}
+
+#endif
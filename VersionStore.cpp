@@ -0,0 +1,189 @@
+#include "VersionStore.h"
+#include "Memory.h"
+
+#include <algorithm>
+#include <atomic>
+
+using namespace std;
+
+const uint64_t IDLE_READER = UINT64_MAX;
+
+// One cache line per slot, so readers announcing themselves do not contend.
+struct alignas(64) ReaderSlot
+{
+    atomic<uint64_t> epoch{IDLE_READER};
+};
+
+struct RetiredMemory
+{
+    uint64_t epoch;
+    size_t bytes;
+    shared_ptr<const void> garbage;
+};
+
+static ReaderSlot readers[VERSION_READER_SLOTS];
+static atomic<uint64_t> globalEpoch(1);
+static atomic<const RosterImage *> currentImage(nullptr);
+
+// Everything below is touched by the interactive thread only.
+static shared_ptr<const RosterImage> published;
+static vector<char> dirtyChunks;
+static vector<RetiredMemory> retired;
+static uint64_t imageNumber = 0;
+
+vector<StudentSpan> RosterImage::spans() const
+{
+    vector<StudentSpan> result;
+    result.reserve(chunks.size());
+    for (const auto &chunk : chunks)
+        result.push_back({chunk->records.data(), chunk->records.size()});
+    return result;
+}
+
+RosterPin::RosterPin(int slot) : slot(slot), pinned(currentImage.load()) {}
+
+RosterPin::~RosterPin()
+{
+    readers[slot].epoch.store(IDLE_READER);
+}
+
+static size_t chunkRecords(size_t chunk, int count)
+{
+    return min<size_t>(VERSION_CHUNK_RECORDS, count - chunk * VERSION_CHUNK_RECORDS);
+}
+
+static bool chunkReusable(size_t chunk, int count)
+{
+    if (!published || chunk >= published->chunks.size())
+        return false;
+    if (chunk < dirtyChunks.size() && dirtyChunks[chunk])
+        return false;
+    return published->chunks[chunk]->records.size() == chunkRecords(chunk, count);
+}
+
+static bool publishedCurrent(int count)
+{
+    return published && published->count == count &&
+           find(dirtyChunks.begin(), dirtyChunks.end(), 1) == dirtyChunks.end();
+}
+
+static size_t chunkBytes(const RosterChunk &chunk)
+{
+    return sizeof(RosterChunk) + chunk.records.capacity() * sizeof(Student);
+}
+
+// Only the chunks no newer image shares are charged to a retired one.
+static void retireImage(shared_ptr<const RosterImage> image)
+{
+    if (!image)
+        return;
+    size_t bytes = sizeof(RosterImage) + vectorBytes(image->chunks);
+    for (const auto &chunk : image->chunks)
+    {
+        if (chunk.use_count() == 1)
+            bytes += chunkBytes(*chunk);
+    }
+    retireRosterMemory(move(image), bytes);
+}
+
+void versionStoreMarkDirty(int index)
+{
+    size_t chunk = index >> VERSION_CHUNK_BITS;
+    if (chunk >= dirtyChunks.size())
+        dirtyChunks.resize(chunk + 1, 0);
+    dirtyChunks[chunk] = 1;
+}
+
+void versionStoreInvalidate()
+{
+    currentImage.store(nullptr);
+    retireImage(move(published));
+    dirtyChunks.clear();
+}
+
+size_t rosterVersionCopyBytes(int count)
+{
+    if (publishedCurrent(count))
+        return 0;
+    size_t bytes = 0;
+    size_t chunks = (count + VERSION_CHUNK_RECORDS - 1) / VERSION_CHUNK_RECORDS;
+    for (size_t c = 0; c < chunks; c++)
+    {
+        if (!chunkReusable(c, count))
+            bytes += chunkRecords(c, count) * sizeof(Student);
+    }
+    return bytes;
+}
+
+// Copy-on-write at chunk granularity: a new image copies the chunks edited
+// since the previous one and shares the rest with it.
+static void publish(const Student *arr, int count)
+{
+    auto image = make_shared<RosterImage>();
+    image->number = ++imageNumber;
+    image->count = count;
+    size_t chunks = (count + VERSION_CHUNK_RECORDS - 1) / VERSION_CHUNK_RECORDS;
+    image->chunks.reserve(chunks);
+    for (size_t c = 0; c < chunks; c++)
+    {
+        if (chunkReusable(c, count))
+        {
+            image->chunks.push_back(published->chunks[c]);
+            continue;
+        }
+        auto chunk = make_shared<RosterChunk>();
+        const Student *first = arr + c * VERSION_CHUNK_RECORDS;
+        chunk->records.assign(first, first + chunkRecords(c, count));
+        image->chunks.push_back(move(chunk));
+    }
+    shared_ptr<const RosterImage> previous = move(published);
+    published = move(image);
+    currentImage.store(published.get());
+    retireImage(move(previous));
+    dirtyChunks.assign(dirtyChunks.size(), 0);
+}
+
+// A reader announces the epoch it starts in before loading the image, so
+// anything retired in a later epoch is invisible to it.
+shared_ptr<RosterPin> pinRosterVersion(const Student *arr, int count)
+{
+    if (!publishedCurrent(count))
+        publish(arr, count);
+    for (int slot = 0; slot < VERSION_READER_SLOTS; slot++)
+    {
+        uint64_t idle = IDLE_READER;
+        if (readers[slot].epoch.compare_exchange_strong(idle, globalEpoch.load()))
+            return shared_ptr<RosterPin>(new RosterPin(slot));
+    }
+    return nullptr;
+}
+
+void retireRosterMemory(shared_ptr<const void> garbage, size_t bytes)
+{
+    retired.push_back({globalEpoch.fetch_add(1), bytes, move(garbage)});
+    reclaimRosterVersions();
+}
+
+void reclaimRosterVersions()
+{
+    uint64_t oldest = IDLE_READER;
+    for (const ReaderSlot &reader : readers)
+        oldest = min(oldest, reader.epoch.load());
+    retired.erase(remove_if(retired.begin(), retired.end(),
+                            [oldest](const RetiredMemory &memory) { return memory.epoch < oldest; }),
+                  retired.end());
+}
+
+size_t rosterVersionBytes()
+{
+    size_t bytes = vectorBytes(dirtyChunks) + vectorBytes(retired);
+    if (published)
+    {
+        bytes += sizeof(RosterImage) + vectorBytes(published->chunks);
+        for (const auto &chunk : published->chunks)
+            bytes += chunkBytes(*chunk);
+    }
+    for (const RetiredMemory &memory : retired)
+        bytes += memory.bytes;
+    return bytes;
+}
@@ -0,0 +1,70 @@
+#ifndef UTP_VERSIONSTORE_H
+#define UTP_VERSIONSTORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "Student.h"
+
+const int VERSION_CHUNK_BITS = 12;
+const int VERSION_CHUNK_RECORDS = 1 << VERSION_CHUNK_BITS;
+const int VERSION_READER_SLOTS = 64;
+
+struct RosterChunk
+{
+    std::vector<Student> records;
+};
+
+// An immutable copy of the roster, positions included (tombstones too).
+// Consecutive images share every chunk that saw no edit in between.
+struct RosterImage
+{
+    std::uint64_t number;
+    int count;
+    std::vector<std::shared_ptr<const RosterChunk>> chunks;
+
+    const Student &at(int index) const
+    {
+        return chunks[index >> VERSION_CHUNK_BITS]->records[index & (VERSION_CHUNK_RECORDS - 1)];
+    }
+    std::vector<StudentSpan> spans() const;
+};
+
+// A reader's hold on one image. While it lives, neither the image nor the
+// string arenas its records point into are freed; pinning and reading take
+// no locks.
+class RosterPin
+{
+public:
+    RosterPin(const RosterPin &) = delete;
+    RosterPin &operator=(const RosterPin &) = delete;
+    ~RosterPin();
+
+    const RosterImage &image() const { return *pinned; }
+
+private:
+    friend std::shared_ptr<RosterPin> pinRosterVersion(const Student *arr, int count);
+
+    explicit RosterPin(int slot);
+
+    int slot;
+    const RosterImage *pinned;
+};
+
+// Writer side, interactive thread only. Edits mark their chunk dirty; a
+// reload or reorder invalidates every chunk.
+void versionStoreMarkDirty(int index);
+void versionStoreInvalidate();
+// Bytes pinRosterVersion() would copy to publish the live roster.
+std::size_t rosterVersionCopyBytes(int count);
+// Publishes the live roster as a new image when it changed since the last
+// one and pins it; nullptr when every reader slot is taken.
+std::shared_ptr<RosterPin> pinRosterVersion(const Student *arr, int count);
+// Memory that readers may still see is retired rather than freed, and
+// released by reclaimRosterVersions() once no reader pinned before it.
+void retireRosterMemory(std::shared_ptr<const void> garbage, std::size_t bytes);
+void reclaimRosterVersions();
+std::size_t rosterVersionBytes();
+
+#endif
@@ -1,18 +1,50 @@
 #include <vector>
 #include <filesystem>
 #include <iomanip>
+#include <sstream>
+#include <ctime>
+#include <cmath>
 #include <limits>
 #ifdef _WIN32
 #include <windows.h>
 #include <io.h>
+#else
+#include <sys/ioctl.h>
+#include <unistd.h>
 #endif
 #include <locale>
 #include <iostream>
 #include <algorithm>
 #include <fstream>
+#include <unordered_map>
 #include "Student.h"
+#include "LazyStore.h"
+#include "Export.h"
+#include "Metrics.h"
+#include "NameIndex.h"
+#include "SurnameIndex.h"
+#include "SlotMap.h"
+#include "BulkEdit.h"
+#include "SortViews.h"
+#include "Snapshot.h"
+#include "BinaryStore.h"
+#include "ChangeLog.h"
+#include "FileLock.h"
+#include "RosterMerge.h"
+#include "Analytics.h"
+#include "RoundTrip.h"
+#include "Memory.h"
+#include "RosterWatch.h"
+#include "RangeIndex.h"
+#include "Duplicates.h"
+#include "DisplayWidth.h"
+#include "VersionStore.h"
+#include "BackgroundJobs.h"
 #include <string>
 #include <codecvt>
+#include <charconv>
+#include <cstring>
+#include <cstdlib>
 
 using namespace std;
 
@@ -20,21 +52,93 @@ Student *students = new Student[10];
 
 int studentCount = 0;
 int capacity = 10;
+int tombstoneCount = 0;
+bool nameIndexesStale = false;
+bool snapshotPending = false;
+bool snapshotPendingBinary = true;
+bool changeLogSynced = false;
+bool watchEnabled = false;
+bool applyingExternalChange = false;
+SortSpec activeSort;
+const vector<int> *exportOrder = nullptr;
+
+const double TOMBSTONE_COMPACT_RATIO = 0.25;
 
 const string FILE1_PATH = "forStudents.txt";
 const string FILE2_PATH = "forStudents.bin";
+const string SNAPSHOT_PATH = "forStudents.snap";
+const string HISTORY_DIR = "forStudents.history";
+const string TEXT_GENERATION_PREFIX = "#generation ";
+const string TEXT_FORMAT_PREFIX = "#format ";
+const int TEXT_FORMAT_VERSION = 2;
+const int TEXT_FIXED_FIELDS = 5;
+const int LEGACY_BINARY_MIN_RECORD = (2 + 3 + 2 * LEGACY_BINARY_SUBJECTS) * sizeof(int);
 
 void processChoice(int choice);
 
-string toLowerUtf8(const string &s);
-int utf8_width(const std::string &s);
+string toLowerUtf8(string_view s);
 void printPadded(const string &s, int width);
-void expandArray();
+bool expandArray();
+void reserveStudents(int count);
+MemoryUsage currentMemory();
+size_t rosterLoadEstimate(long long records, long long bytes);
+bool degradeIfOverBudget(const string &path, bool binary, size_t needed);
+bool openLazyRoster(const string &path, bool binary);
+void watchLoadedRoster(const RosterVersion &version, bool binary);
+void applyRosterDeltas();
+void applyExternalDelta(const RosterDelta &delta);
 void editStudent(int index);
+void storeEditedStudent(int index, const Student &student, Student &before);
 void deleteStudent(int index);
-void printArray();
+bool studentLive(int index);
+int liveStudentCount();
+void assignStudentIds();
+void compactStudents();
+void printStudentBrief(int index);
+void printArray(int limit = 0);
+void printStudentRows(const vector<const Student *> &rows, const vector<int> &numbers);
+void printLazyPages();
+bool materializeLazyStore();
+void persistStudents();
+const Student &studentAt(int index);
+const Student &viewStudentAt(int index);
+void exportMenu();
+bool exportCurrent(const ExportFormat &format, const string &path);
+shared_ptr<RosterPin> pinRoster();
+const Student &imageStudentAt(int index);
+bool exportInBackground(const ExportFormat &format, const string &path);
+bool choiceNeedsRoster(int choice);
+void fuzzySearchMenu();
+void rangeQueryMenu();
+void duplicatesMenu();
+void reportLoadedDuplicates();
+void bulkEditMenu();
+void historyMenu();
+void syncChangeLogWithRoster();
+void checkpointChangeLogIfDue();
+string formatChangeTime(int64_t timestamp);
+void printChangeEvent(const ChangeEvent &event);
+void printChangeState(uint64_t sequence);
+void analyticsMenu();
+void printAnalytics(const RosterAnalytics &analytics, AnalyticsGrouping grouping, int cohortWidth,
+                    const string &filter);
+void printTextTable(const vector<string> &headers, const vector<vector<string>> &rows);
+string formatDecimal(double value, int precision);
+void stageRoundTrip(const vector<RoundTripRecord> &records);
+void collectRoundTrip(vector<RoundTripRecord> &records);
+void saveWithLazyEdits();
+bool runRoundTripMode(const vector<size_t> &tiers);
+int selectStudent(const string &action);
+void ensureNameIndexes();
+void onRosterReloaded();
+void onRosterReordered();
+void onStudentInserted(int index);
+void recordStudentUpdate(int index, const Student &before);
+void onStudentUpdated(int index, const Student &before);
+void onStudentErased(int index, bool reindex = true);
+void eraseStudent(int index, bool reindex);
 int getConsoleWidth();
-void addStudentToArray(const Student &student);
+bool addStudentToArray(const Student &student);
 void sortStudentsByYear();
 void sortStudents(int sortBy, bool ascending = true);
 bool checkAvailability();
@@ -42,18 +146,36 @@ void saveToFile();
 void loadFromFile();
 void saveToBinaryFile();
 void loadFromBinaryFile();
+bool loadFromSnapshot();
+void refreshSnapshot(const string &sourcePath, bool binary);
+void flushPendingSnapshot();
+void autoOpenDataset();
+bool openSnapshotView();
+void loadDatasetSource();
+void releaseRosterForLazyStore();
 bool askPermission1();
 bool askPermission2();
 bool isNumber(string s);
-bool checkGrades(string s);
+bool checkGrades(string_view s);
 bool parseIntWithLimit(const string &s, int maxLen, int &value);
-bool isValidName(const string &s);
+bool isValidName(string_view s);
 bool isValidCourse(int course);
 bool isValidYear(int year);
-bool isValidSubject(const string &s);
-bool splitLine(const string &line, char delimiter, vector<string> &fields, int expectedFields);
-bool parseGradesSumCount(const string &grades, int &sum, int &count);
+bool isValidSubject(string_view s);
+SubjectList inputSubjects();
 double calcAverageGrade(const Student &student);
+void writeTextStudent(ostream &out, const Student &student);
+bool parseTextStudent(string_view line, Student &student);
+bool writeBinaryStudent(ostream &out, const Student &student);
+bool decodeBinaryStudent(const char *&p, const char *end, Student &student);
+bool readWholeFile(const string &path, vector<char> &buffer);
+bool parseTextGeneration(string_view line, uint64_t &generation);
+bool textFormatSupported(string_view text);
+uint64_t textFileGeneration(const string &path);
+RosterVersion observeRoster(const string &path, bool binary);
+bool readRosterFile(const string &path, bool binary, vector<Student> &records);
+void replaceRoster(vector<Student> &records);
+void mergeStaleRoster(const RosterVersion &current, bool binary);
 
 bool isNumber(string s)
 {
@@ -67,50 +189,11 @@ bool isNumber(string s)
     return true;
 }
 
-bool checkGrades(string s)
+bool checkGrades(string_view s)
 {
-    if (s.empty())
-        return false;
-
-    int gradeCount = 0;
-    string current = "";
-
-    for (size_t i = 0; i < s.size(); i++)
-    {
-        char c = s[i];
-
-        if (isdigit(c))
-        {
-            current.push_back(c);
-        }
-        else if (c == ',')
-        {
-            if (current.empty())
-                return false;
-            int g = 0;
-            if (!parseIntWithLimit(current, 1, g))
-                return false;
-            if (g < 1 || g > 5)
-                return false;
-            gradeCount++;
-            current.clear();
-        }
-        else
-        {
-            return false;
-        }
-    }
-
-    if (current.empty())
-        return false;
-    int g = 0;
-    if (!parseIntWithLimit(current, 1, g))
-        return false;
-    if (g < 1 || g > 5)
-        return false;
-    gradeCount++;
-
-    return gradeCount == 3;
+    metricCount(METRIC_VALIDATE);
+    string grades;
+    return parseGradeList(s, grades);
 }
 
 bool parseIntWithLimit(const string &s, int maxLen, int &value)
@@ -126,8 +209,9 @@ bool parseIntWithLimit(const string &s, int maxLen, int &value)
     return true;
 }
 
-bool isValidName(const string &s)
+bool isValidName(string_view s)
 {
+    metricCount(METRIC_VALIDATE);
     if (s.empty())
         return false;
 
@@ -178,16 +262,19 @@ bool isValidName(const string &s)
 
 bool isValidCourse(int course)
 {
-    return course >= 1 && course <= 6;
+    metricCount(METRIC_VALIDATE);
+    return course >= STUDENT_COURSE_MIN && course <= STUDENT_COURSE_MAX;
 }
 
 bool isValidYear(int year)
 {
-    return year >= 1930 && year <= 2010;
+    metricCount(METRIC_VALIDATE);
+    return year >= STUDENT_YEAR_MIN && year <= STUDENT_YEAR_MAX;
 }
 
-bool isValidSubject(const string &s)
+bool isValidSubject(string_view s)
 {
+    metricCount(METRIC_VALIDATE);
     if (s.empty())
         return false;
 
@@ -236,7 +323,46 @@ bool isValidSubject(const string &s)
     return true;
 }
 
-int main()
+SubjectList inputSubjects()
+{
+    string input;
+    int count = 0;
+    while (true)
+    {
+        cout << "Сколько предметов (1-" << MAX_SUBJECTS << "): ";
+        getline(cin, input);
+        if (parseIntWithLimit(input, 2, count) && count >= 1 && count <= MAX_SUBJECTS)
+            break;
+        cout << "Ошибка: введите число от 1 до " << MAX_SUBJECTS << ".\n";
+    }
+
+    SubjectListBuilder builder;
+    for (int i = 0; i < count; i++)
+    {
+        string subject;
+        while (true)
+        {
+            cout << "Введите предмет " << i + 1 << " (только русские или английские буквы): ";
+            getline(cin, subject);
+            if (isValidSubject(subject))
+                break;
+            cout << "Ошибка: название предмета может содержать только русские или английские буквы.\n";
+        }
+
+        while (true)
+        {
+            cout << "Введите оценки (1–5 через запятую, не больше " << MAX_GRADES_PER_SUBJECT
+                 << ", например: 5,4,3): ";
+            getline(cin, input);
+            if (checkGrades(input) && builder.add(subject, input))
+                break;
+            cout << "Ошибка: введите от 1 до " << MAX_GRADES_PER_SUBJECT << " оценок (числа 1–5 через запятую).\n";
+        }
+    }
+    return builder.build();
+}
+
+int main(int argc, char *argv[])
 {
 #ifdef _WIN32
     SetConsoleOutputCP(CP_UTF8);
@@ -244,8 +370,94 @@ int main()
 #endif
     std::locale::global(std::locale(""));
 
+    bool lazyBinary = false;
+    bool lazy = false;
+    string exportFormat;
+    string exportPath = "-";
+    string metricsPath;
+    bool autoOpen = true;
+    bool watch = true;
+    vector<size_t> roundTripTiers;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--lazy" || arg == "--lazy-bin")
+        {
+            lazy = true;
+            lazyBinary = arg == "--lazy-bin";
+        }
+        else if (arg.rfind("--export=", 0) == 0)
+            exportFormat = arg.substr(9);
+        else if (arg.rfind("--out=", 0) == 0)
+            exportPath = arg.substr(6);
+        else if (arg.rfind("--metrics-json=", 0) == 0)
+            metricsPath = arg.substr(15);
+        else if (arg == "--no-metrics")
+            metricsEnabled = false;
+        else if (arg == "--no-autoload")
+            autoOpen = false;
+        else if (arg == "--no-watch")
+            watch = false;
+        else if (arg.rfind("--memory-budget=", 0) == 0)
+        {
+            if (!parseMemoryBudget(arg.substr(16), memoryBudget))
+            {
+                cout << "Неверный бюджет памяти: " << arg.substr(16) << "\n";
+                return 1;
+            }
+        }
+        else if (arg == "--roundtrip")
+            roundTripTiers.assign(begin(ROUND_TRIP_TIERS), end(ROUND_TRIP_TIERS));
+        else if (arg.rfind("--roundtrip=", 0) == 0)
+        {
+            size_t records = 0;
+            auto parsed = from_chars(arg.data() + 12, arg.data() + arg.size(), records);
+            if (parsed.ec != errc() || parsed.ptr != arg.data() + arg.size() || records == 0)
+            {
+                cout << "Неверное число записей: " << arg.substr(12) << "\n";
+                return 1;
+            }
+            roundTripTiers.push_back(records);
+        }
+        else
+            cout << "Неизвестный параметр: " << arg << "\n";
+    }
+
+    if (!exportFormat.empty())
+    {
+        const ExportFormat *format = findExportFormat(exportFormat);
+        if (exportPath == "-")
+            cout.rdbuf(cerr.rdbuf());
+        if (!format)
+        {
+            cout << "Неизвестный формат экспорта: " << exportFormat << "\n";
+            return 1;
+        }
+        if (!openLazyStore(lazyBinary ? FILE2_PATH : FILE1_PATH, lazyBinary))
+            return 1;
+        bool exported = exportCurrent(*format, exportPath);
+        if (!metricsPath.empty())
+            dumpMetricsJson(metricsPath);
+        return exported ? 0 : 1;
+    }
+    if (!roundTripTiers.empty())
+    {
+        bool passed = runRoundTripMode(roundTripTiers);
+        if (!metricsPath.empty())
+            dumpMetricsJson(metricsPath);
+        return passed ? 0 : 1;
+    }
+    watchEnabled = watch;
+    if (lazy)
+        openLazyStore(lazyBinary ? FILE2_PATH : FILE1_PATH, lazyBinary);
+    else if (autoOpen)
+        autoOpenDataset();
+
     while (true)
     {
+        applyRosterDeltas();
+        finishBackgroundJobs(false);
+        reclaimRosterVersions();
         int choice;
         cout << "\nМеню:\n";
         cout << "1) Добавить студента\n";
@@ -257,18 +469,46 @@ int main()
         cout << "7) Показать список\n";
         cout << "8) Сортировать студентов\n";
         cout << "9) Выход\n";
+        cout << "10) Экспорт (CSV, JSONL, Markdown, фиксированная ширина)\n";
+        cout << "11) Статистика операций\n";
+        cout << "12) Нечёткий поиск по ФИО\n";
+        cout << "13) Массовое удаление или изменение по условию\n";
+        cout << "14) История изменений\n";
+        cout << "15) Аналитика оценок по предметам, курсам и годам рождения\n";
+        cout << "16) Поиск по диапазону годов рождения и курсов\n";
+        cout << "17) Поиск и объединение дубликатов\n";
+        if (lazyStoreSnapshot())
+            cout << "(открыт снимок: " << lazyRecordCount() << " записей, весь список загрузится по первой правке)\n";
+        else if (lazyStoreActive())
+            cout << "(ленивый режим: " << lazyRecordCount() << " записей в файле)\n";
+        if (runningBackgroundJobs() > 0)
+            cout << "(фоновых задач: " << runningBackgroundJobs() << ")\n";
         cout << "Выберите пункт: ";
         cin >> choice;
 
         if (choice == 9)
             break;
         processChoice(choice);
+        checkpointChangeLogIfDue();
     }
+    finishBackgroundJobs(true);
+    stopRosterWatcher();
+    flushPendingSnapshot();
+    if (!metricsPath.empty())
+        dumpMetricsJson(metricsPath);
     return 0;
 }
 
 void processChoice(int choice)
 {
+    if (lazyStoreActive() && choiceNeedsRoster(choice))
+    {
+        if (!materializeLazyStore())
+            return;
+    }
+    if (choice == 1 || choice == 2 || choice == 3 || choice == 12 || choice == 13 || choice == 17)
+        syncChangeLogWithRoster();
+
     switch (choice)
     {
 
@@ -283,27 +523,36 @@ void processChoice(int choice)
         while (true)
         {
             cout << "Введите имя (только русские или английские буквы): ";
-            getline(cin, student.name);
-            if (isValidName(student.name))
+            getline(cin, input);
+            if (isValidName(input))
+            {
+                student.name = input;
                 break;
+            }
             cout << "Ошибка: имя может содержать только русские или английские буквы.\n";
         }
 
         while (true)
         {
             cout << "Введите фамилию (только русские или английские буквы): ";
-            getline(cin, student.surname);
-            if (isValidName(student.surname))
+            getline(cin, input);
+            if (isValidName(input))
+            {
+                student.surname = input;
                 break;
+            }
             cout << "Ошибка: фамилия может содержать только русские или английские буквы.\n";
         }
 
         while (true)
         {
             cout << "Введите отчество (только русские или английские буквы): ";
-            getline(cin, student.middleName);
-            if (isValidName(student.middleName))
+            getline(cin, input);
+            if (isValidName(input))
+            {
+                student.middleName = input;
                 break;
+            }
             cout << "Ошибка: отчество может содержать только русские или английские буквы.\n";
         }
 
@@ -363,49 +612,26 @@ void processChoice(int choice)
             }
         }
 
-        for (int i = 0; i < 3; i++)
-        {
-            while (true)
-            {
-                cout << "Введите предмет " << i + 1 << " (только русские или английские буквы): ";
-                getline(cin, student.subjects[i]);
-                if (isValidSubject(student.subjects[i]))
-                    break;
-                cout << "Ошибка: название предмета может содержать только русские или английские буквы.\n";
-            }
-
-            while (true)
-            {
-                cout << "Введите 3 оценки (1–5, через запятую, например: 5,4,3): ";
-                getline(cin, student.grades[i]);
-                if (checkGrades(student.grades[i]))
-                    break;
-                cout << "Ошибка: введите ровно 3 оценки (числа 1–5 через запятую).\n";
-            }
-        }
+        student.subjects = inputSubjects();
 
-        addStudentToArray(student);
-        saveToFile();
+        if (addStudentToArray(student))
+            saveToFile();
         break;
     }
 
     case 2:
     {
-        printArray();
-        cout << "Введите номер студента для редактирования: ";
-        int index;
-        cin >> index;
-        editStudent(index);
+        int index = selectStudent("редактирования");
+        if (index > 0)
+            editStudent(index);
         break;
     }
 
     case 3:
     {
-        printArray();
-        cout << "Введите номер студента для удаления: ";
-        int index;
-        cin >> index;
-        deleteStudent(index - 1);
+        int index = selectStudent("удаления");
+        if (index > 0)
+            deleteStudent(index - 1);
         break;
     }
 
@@ -422,6 +648,8 @@ void processChoice(int choice)
         cout << "\nЗагрузить из:\n";
         cout << "1) Текстового файла\n";
         cout << "2) Бинарного файла\n";
+        cout << "3) Текстового файла (ленивый режим)\n";
+        cout << "4) Бинарного файла (ленивый режим)\n";
         cout << "Выберите источник: ";
 
         int loadChoice;
@@ -435,6 +663,10 @@ void processChoice(int choice)
         {
             loadFromBinaryFile();
         }
+        else if (loadChoice == 3 || loadChoice == 4)
+        {
+            openLazyRoster(loadChoice == 3 ? FILE1_PATH : FILE2_PATH, loadChoice == 4);
+        }
         else
         {
             cout << "Неверный выбор.\n";
@@ -443,37 +675,65 @@ void processChoice(int choice)
     }
 
     case 7:
-        printArray();
+        if (lazyStoreActive())
+            printLazyPages();
+        else
+            printArray();
         break;
 
     case 8:
     {
         cout << "\nСортировать по:\n";
+        cout << "0) Порядку файла\n";
         cout << "1) Году рождения\n";
         cout << "2) Курсу\n";
         cout << "3) Имени\n";
         cout << "4) Фамилии\n";
         cout << "5) Отчеству\n";
         cout << "6) Оценкам\n";
+        cout << "7) Нескольким полям\n";
         cout << "Выберите поле для сортировки: ";
 
         int sortChoice;
         cin >> sortChoice;
 
-        if (sortChoice >= 1 && sortChoice <= 6)
+        if (sortChoice >= SORT_NONE && sortChoice <= SORT_FIELD_COUNT)
         {
-            cout << "Порядок:\n";
-            cout << "1) По возрастанию\n";
-            cout << "2) По убыванию\n";
-            cout << "Выберите порядок: ";
+            SortSpec spec;
+            if (sortChoice == SORT_FIELD_COUNT)
+            {
+                cin.ignore(numeric_limits<streamsize>::max(), '\n');
+                cout << "Поля: year, course, name, surname, middlename, avg (или год, курс, имя, фамилия, отчество, балл).\n";
+                cout << "Введите порядок (например: course asc, surname asc, avg desc): ";
+                string line;
+                getline(cin, line);
+                string error;
+                if (!parseSortSpec(line, spec, error))
+                {
+                    cout << "Ошибка: " << error << ".\n";
+                    break;
+                }
+            }
+            else if (sortChoice != SORT_NONE)
+            {
+                cout << "Порядок:\n";
+                cout << "1) По возрастанию\n";
+                cout << "2) По убыванию\n";
+                cout << "Выберите порядок: ";
+
+                int orderChoice;
+                cin >> orderChoice;
+                spec.push_back({(SortField)sortChoice, orderChoice == 1});
+            }
 
-            int orderChoice;
-            cin >> orderChoice;
+            cout << "Сколько записей показать (0 — все): ";
+            int limit;
+            cin >> limit;
 
-            bool ascending = (orderChoice == 1);
-            sortStudents(sortChoice, ascending);
-            cout << "Студенты отсортированы.\n\n";
-            printArray();
+            bool cached = sortViewBuilt(spec);
+            activeSort = spec;
+            cout << "Порядок вывода: " << sortSpecName(spec) << (cached ? " (из кэша)" : "") << ".\n\n";
+            printArray(limit);
         }
         else
         {
@@ -482,12 +742,56 @@ void processChoice(int choice)
         break;
     }
 
+    case 10:
+        exportMenu();
+        break;
+
+    case 11:
+        printMetrics();
+        cout << "Несохранённых изменений для бинарного файла: " << binaryStoreDirtyCount() << "\n";
+        printMemoryReport(currentMemory(), liveStudentCount());
+        cout << "Выделений в куче для имён длиннее " << InlineName::CAPACITY << " байт: " << inlineNameOverflows()
+             << "\n";
+        break;
+
+    case 12:
+        fuzzySearchMenu();
+        break;
+
+    case 13:
+        bulkEditMenu();
+        break;
+
+    case 14:
+        historyMenu();
+        break;
+
+    case 15:
+        analyticsMenu();
+        break;
+
+    case 16:
+        rangeQueryMenu();
+        break;
+
+    case 17:
+        duplicatesMenu();
+        break;
+
     default:
         cout << "Неверный пункт меню.\n";
         break;
     }
 }
 
+bool choiceNeedsRoster(int choice)
+{
+    if (choice == 2 && lazyStoreSnapshot())
+        return true;
+    return choice == 1 || choice == 3 || choice == 4 || choice == 5 || choice == 8 || choice == 12 || choice == 13 ||
+           choice == 14 || choice == 15 || choice == 16 || choice == 17;
+}
+
 int getConsoleWidth()
 {
 #ifdef _WIN32
@@ -498,94 +802,17 @@ int getConsoleWidth()
     }
     return 120;
 #else
+    winsize size;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_col > 0)
+        return size.ws_col;
+    const char *columns = getenv("COLUMNS");
+    int width = 0;
+    if (columns && parseIntWithLimit(columns, 4, width) && width > 0)
+        return width;
     return 120;
 #endif
 }
 
-int utf8_width(const string &s)
-{
-    int count = 0;
-    for (size_t i = 0; i < s.size();)
-    {
-        unsigned char c = s[i];
-        int len = 1;
-
-        if ((c & 0x80) == 0)
-            len = 1;
-        else if ((c & 0xE0) == 0xC0)
-            len = 2;
-        else if ((c & 0xF0) == 0xE0)
-            len = 3;
-        else if ((c & 0xF8) == 0xF0)
-            len = 4;
-
-        i += len;
-        count++;
-    }
-    return count;
-}
-
-string utf8_substr(const string &s, int start, int length)
-{
-    if (start < 0 || length <= 0)
-        return "";
-
-    string result = "";
-    int charCount = 0;
-    int collected = 0;
-
-    for (size_t i = 0; i < s.size() && collected < length;)
-    {
-        unsigned char c = s[i];
-        int len = 1;
-
-        if ((c & 0x80) == 0)
-            len = 1;
-        else if ((c & 0xE0) == 0xC0)
-            len = 2;
-        else if ((c & 0xF0) == 0xE0)
-            len = 3;
-        else if ((c & 0xF8) == 0xF0)
-            len = 4;
-
-        if (charCount >= start)
-        {
-            result += s.substr(i, len);
-            collected++;
-        }
-
-        i += len;
-        charCount++;
-    }
-
-    return result;
-}
-
-vector<string> wrapUtf8(const string &s, int maxWidth)
-{
-    vector<string> lines;
-    if (maxWidth <= 0)
-        return lines;
-
-    int totalChars = utf8_width(s);
-    if (totalChars <= maxWidth)
-    {
-        lines.push_back(s);
-        return lines;
-    }
-
-    int start = 0;
-    while (start < totalChars)
-    {
-        int chunkSize = min(maxWidth, totalChars - start);
-        string chunk = utf8_substr(s, start, chunkSize);
-        lines.push_back(chunk);
-        start += chunkSize;
-    }
-
-    return lines;
-}
-
 void printSeparatorLine(const vector<int> &colWidths)
 {
     int totalWidth = 1;
@@ -615,8 +842,8 @@ void printWrappedRow(const vector<vector<string>> &wrappedCols, const vector<int
                 cellContent = wrappedCols[col][line];
             }
 
-            int contentWidth = utf8_width(cellContent);
-            int padding = colWidths[col] - contentWidth;
+            int contentWidth = displayWidth(cellContent);
+            int padding = max(0, colWidths[col] - contentWidth);
 
             cout << cellContent;
             cout << string(padding + 1, ' ');
@@ -626,17 +853,34 @@ void printWrappedRow(const vector<vector<string>> &wrappedCols, const vector<int
     }
 }
 
-void printArray()
+void printArray(int limit)
 {
-    if (studentCount == 0)
+    if (liveStudentCount() == 0)
     {
         cout << "Нет студентов.\n";
         return;
     }
 
-    vector<string> headers = {
-        "№", "Год", "Курс", "Имя", "Фамилия", "Отчество",
-        "Предмет 1", "Оценки 1", "Предмет 2", "Оценки 2", "Предмет 3", "Оценки 3"};
+    const vector<int> &order = sortView(activeSort, students, studentCount);
+    size_t shown = limit > 0 ? min(order.size(), (size_t)limit) : order.size();
+    vector<const Student *> rows(shown);
+    vector<int> numbers(shown);
+    for (size_t i = 0; i < shown; i++)
+    {
+        rows[i] = &students[order[i]];
+        numbers[i] = order[i] + 1;
+    }
+    printStudentRows(rows, numbers);
+}
+
+void printStudentRows(const vector<const Student *> &rows, const vector<int> &numbers)
+{
+    MetricTimer timer(METRIC_PRINT);
+    metricAddRecords(METRIC_PRINT, rows.size());
+    bool showIds = !rows.empty() && rows[0]->id != INVALID_STUDENT_ID;
+    vector<string> headers = {"№", "Год", "Курс", "Имя", "Фамилия", "Отчество", "Предметы и оценки"};
+    if (showIds)
+        headers.insert(headers.begin() + 1, "ID");
 
     int consoleWidth = getConsoleWidth();
     int estimatedCols = headers.size();
@@ -647,62 +891,72 @@ void printArray()
 
     for (size_t i = 0; i < headers.size(); i++)
     {
-        colWidths[i] = min(MAX_CELL_WIDTH, utf8_width(headers[i]));
+        colWidths[i] = min(MAX_CELL_WIDTH, displayWidth(headers[i]));
     }
+    colWidths.back() = displayWidth(headers.back());
 
-    for (int i = 0; i < studentCount; i++)
+    for (size_t i = 0; i < rows.size(); i++)
     {
+        const Student &student = *rows[i];
         vector<string> rowData = {
-            to_string(i + 1),
-            to_string(students[i].year),
-            to_string(students[i].course),
-            students[i].name,
-            students[i].surname,
-            students[i].middleName,
-            students[i].subjects[0],
-            students[i].grades[0],
-            students[i].subjects[1],
-            students[i].grades[1],
-            students[i].subjects[2],
-            students[i].grades[2]};
+            to_string(numbers[i]),
+            to_string(student.year),
+            to_string(student.course),
+            student.name.str(),
+            student.surname.str(),
+            student.middleName.str()};
+        if (showIds)
+            rowData.insert(rowData.begin() + 1, to_string(student.id));
 
         for (size_t j = 0; j < rowData.size(); j++)
         {
-            int contentWidth = utf8_width(rowData[j]);
+            int contentWidth = displayWidth(rowData[j]);
             int requiredWidth = min(MAX_CELL_WIDTH, contentWidth);
             colWidths[j] = max(colWidths[j], requiredWidth);
         }
+        for (int k = 0; k < student.subjects.size(); k++)
+        {
+            string line = string(student.subjects.subject(k)) + ": " + student.subjects.gradesText(k);
+            colWidths.back() = max(colWidths.back(), displayWidth(line));
+        }
     }
+    int usedWidth = 1;
+    for (size_t j = 0; j + 1 < colWidths.size(); j++)
+        usedWidth += colWidths[j] + 3;
+    colWidths.back() = min(colWidths.back(), max(MAX_CELL_WIDTH, maxTableWidth - usedWidth - 3));
 
     vector<vector<string>> headerWrapped(headers.size());
     for (size_t i = 0; i < headers.size(); i++)
     {
-        headerWrapped[i] = wrapUtf8(headers[i], colWidths[i]);
+        headerWrapped[i] = wrapToWidth(headers[i], colWidths[i]);
     }
     printWrappedRow(headerWrapped, colWidths);
 
     printSeparatorLine(colWidths);
 
-    for (int i = 0; i < studentCount; i++)
+    for (size_t i = 0; i < rows.size(); i++)
     {
+        const Student &student = *rows[i];
         vector<string> rowData = {
-            to_string(i + 1),
-            to_string(students[i].year),
-            to_string(students[i].course),
-            students[i].name,
-            students[i].surname,
-            students[i].middleName,
-            students[i].subjects[0],
-            students[i].grades[0],
-            students[i].subjects[1],
-            students[i].grades[1],
-            students[i].subjects[2],
-            students[i].grades[2]};
-
-        vector<vector<string>> wrappedRow(rowData.size());
+            to_string(numbers[i]),
+            to_string(student.year),
+            to_string(student.course),
+            student.name.str(),
+            student.surname.str(),
+            student.middleName.str()};
+        if (showIds)
+            rowData.insert(rowData.begin() + 1, to_string(student.id));
+
+        vector<vector<string>> wrappedRow(rowData.size() + 1);
         for (size_t j = 0; j < rowData.size(); j++)
         {
-            wrappedRow[j] = wrapUtf8(rowData[j], colWidths[j]);
+            wrappedRow[j] = wrapToWidth(rowData[j], colWidths[j]);
+        }
+        for (int k = 0; k < student.subjects.size(); k++)
+        {
+            string line = string(student.subjects.subject(k)) + ": " + student.subjects.gradesText(k);
+            for (string &part : wrapToWidth(line, colWidths.back()))
+                wrappedRow.back().push_back(move(part));
         }
 
         printWrappedRow(wrappedRow, colWidths);
@@ -711,140 +965,1211 @@ void printArray()
     }
 }
 
-void sortStudentsByYear()
-{
-    sortStudents(1);
-}
-
-void sortStudents(int sortBy, bool ascending)
+void printLazyPages()
 {
-    if (studentCount <= 1)
+    int total = lazyRecordCount();
+    if (total == 0)
+    {
+        cout << "Нет студентов.\n";
         return;
+    }
 
-    for (int i = 0; i < studentCount - 1; i++)
+    int pages = (total + LAZY_PAGE_SIZE - 1) / LAZY_PAGE_SIZE;
+    int page = 0;
+    while (true)
     {
-        for (int j = 0; j < studentCount - i - 1; j++)
+        int first = page * LAZY_PAGE_SIZE;
+        int last = min(total, first + LAZY_PAGE_SIZE);
+        vector<const Student *> rows;
+        vector<int> numbers;
+        for (int i = first; i < last; i++)
         {
-            bool shouldSwap = false;
-
-            switch (sortBy)
-            {
-            case 1:
-                shouldSwap = ascending ? (students[j].year > students[j + 1].year) : (students[j].year < students[j + 1].year);
-                break;
-            case 2:
-                shouldSwap = ascending ? (students[j].course > students[j + 1].course) : (students[j].course < students[j + 1].course);
-                break;
-            case 3:
-            {
-                string name1 = toLowerUtf8(students[j].name);
-                string name2 = toLowerUtf8(students[j + 1].name);
-                shouldSwap = ascending ? (name1 > name2) : (name1 < name2);
-                break;
-            }
-            case 4:
-            {
-                string surname1 = toLowerUtf8(students[j].surname);
-                string surname2 = toLowerUtf8(students[j + 1].surname);
-                shouldSwap = ascending ? (surname1 > surname2) : (surname1 < surname2);
-                break;
-            }
-            case 5:
-            {
-                string middle1 = toLowerUtf8(students[j].middleName);
-                string middle2 = toLowerUtf8(students[j + 1].middleName);
-                shouldSwap = ascending ? (middle1 > middle2) : (middle1 < middle2);
-                break;
-            }
-            case 6:
-            {
-                double avg1 = calcAverageGrade(students[j]);
-                double avg2 = calcAverageGrade(students[j + 1]);
-                shouldSwap = ascending ? (avg1 > avg2) : (avg1 < avg2);
-                break;
-            }
-            default:
-                cout << "Неверный параметр сортировки.\n";
-                return;
-            }
-
-            if (shouldSwap)
-            {
-                Student temp = students[j];
-                students[j] = students[j + 1];
-                students[j + 1] = temp;
-            }
+            rows.push_back(&lazyGet(i));
+            numbers.push_back(i + 1);
         }
+        printStudentRows(rows, numbers);
+
+        cout << "Страница " << page + 1 << " из " << pages
+             << " (n — следующая, p — предыдущая, номер — перейти, q — выход): ";
+        string answer;
+        cin >> answer;
+        if (answer == "n" && page + 1 < pages)
+            page++;
+        else if (answer == "p" && page > 0)
+            page--;
+        else if (isNumber(answer) && answer.size() <= 9 && stoi(answer) >= 1 && stoi(answer) <= pages)
+            page = stoi(answer) - 1;
+        else if (answer == "q")
+            return;
     }
 }
 
-bool checkAvailability()
+const Student &studentAt(int index)
 {
-    if (studentCount + 1 > capacity)
-        expandArray();
-    return true;
+    return students[index];
 }
 
-void addStudentToArray(const Student &student)
+const Student &viewStudentAt(int index)
 {
-    checkAvailability();
-    students[studentCount] = student;
-    studentCount++;
-    cout << "Студент успешно добавлен.\n";
+    return students[(*exportOrder)[index]];
 }
 
-void deleteStudent(int index)
+bool exportCurrent(const ExportFormat &format, const string &path)
 {
-    if (index < 0 || index >= studentCount)
+    if (lazyStoreActive())
+        return exportStudents(format, path, lazyRecordCount(), lazyGet);
+    if (!activeSort.empty())
     {
-        cout << "Неверный номер студента.\n";
-        return;
+        exportOrder = &sortView(activeSort, students, studentCount);
+        return exportStudents(format, path, exportOrder->size(), viewStudentAt);
     }
-    for (int i = index; i < studentCount - 1; i++)
-        students[i] = students[i + 1];
-
-    studentCount--;
-    cout << "Студент удалён.\n";
-    saveToFile();
+    if (tombstoneCount > 0)
+        compactStudents();
+    return exportStudents(format, path, studentCount, studentAt);
 }
 
-void expandArray()
+// Pins the live roster for a background job; nullptr when the copy would
+// not fit into the memory budget or every reader slot is taken.
+shared_ptr<RosterPin> pinRoster()
 {
-    int newCapacity = capacity * 2;
-    Student *newStudents = new Student[newCapacity];
-    for (int i = 0; i < capacity; i++)
-        newStudents[i] = students[i];
+    if (memoryBudget != 0)
+    {
+        size_t needed = currentMemory().total() + rosterVersionCopyBytes(studentCount);
+        if (!memoryBudgetAllows(needed))
+        {
+            cout << "Копия списка для фоновой задачи не помещается в бюджет памяти (" << formatBytes(needed)
+                 << "), задача выполняется сразу.\n";
+            return nullptr;
+        }
+    }
+    return pinRosterVersion(students, studentCount);
+}
 
-    delete[] students;
-    students = newStudents;
-    capacity = newCapacity;
+static thread_local const RosterImage *jobImage = nullptr;
+static thread_local const vector<int> *jobOrder = nullptr;
 
-    cout << "Размер массива увеличен: " << capacity << "\n";
+const Student &imageStudentAt(int index)
+{
+    return jobImage->at((*jobOrder)[index]);
 }
 
-void editStudent(int index)
+// Exports the roster as it is now while the menu stays usable: the order is
+// taken on this thread, the records are read from the pinned version.
+bool exportInBackground(const ExportFormat &format, const string &path)
 {
-    if (index < 1 || index > studentCount)
+    shared_ptr<RosterPin> pin = pinRoster();
+    if (!pin)
+        return false;
+    vector<int> order;
+    if (!activeSort.empty())
+        order = sortView(activeSort, students, studentCount);
+    else
     {
-        cout << "Неверный номер студента.\n";
+        order.reserve(liveStudentCount());
+        for (int i = 0; i < studentCount; i++)
+        {
+            if (studentLive(i))
+                order.push_back(i);
+        }
+    }
+    startBackgroundJob("экспорт в " + path, [&format, path, pin, order]() {
+        auto report = make_shared<ostringstream>();
+        jobImage = &pin->image();
+        jobOrder = &order;
+        exportStudents(format, path, order.size(), imageStudentAt, *report);
+        return function<void()>([report] { cout << report->str(); });
+    });
+    return true;
+}
+
+void exportMenu()
+{
+    const vector<ExportFormat> &formats = exportFormats();
+    cout << "\nФормат экспорта:\n";
+    for (size_t i = 0; i < formats.size(); i++)
+        cout << i + 1 << ") " << formats[i].description << "\n";
+    cout << "Выберите формат: ";
+
+    int formatChoice;
+    cin >> formatChoice;
+    if (formatChoice < 1 || formatChoice > (int)formats.size())
+    {
+        cout << "Неверный выбор.\n";
         return;
     }
 
-    index--;
+    cout << "Введите путь к файлу (- для вывода на экран): ";
+    string path;
+    cin >> path;
+    const ExportFormat &format = formats[formatChoice - 1];
+    if (path == "-" || lazyStoreActive() || liveStudentCount() < BACKGROUND_JOB_MIN_RECORDS ||
+        !exportInBackground(format, path))
+        exportCurrent(format, path);
+}
 
+void fuzzySearchMenu()
+{
     cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    cout << "Введите ФИО или его часть (допускаются опечатки, кириллица или латиница): ";
+    string query;
+    getline(cin, query);
 
-    while (true)
+    ensureNameIndexes();
+    vector<NameMatch> matches = fuzzySearchNames(query, 20);
+    if (matches.empty())
     {
-        cout << "\nЧто хотите изменить?\n";
-        cout << "1) Год рождения\n";
-        cout << "2) Курс\n";
-        cout << "3) Имя\n";
-        cout << "4) Фамилия\n";
-        cout << "5) Отчество\n";
-        cout << "6) Предметы и оценки\n";
-        cout << "7) Выход\n";
-        cout << "Выберите пункт: ";
+        cout << "Совпадений не найдено.\n";
+        return;
+    }
+
+    cout << "Найдено (номер или #ID для редактирования/удаления):\n";
+    for (const NameMatch &match : matches)
+    {
+        printStudentBrief(match.index);
+        cout << " (отличий: " << match.distance << ")\n";
+    }
+}
+
+void rangeQueryMenu()
+{
+    const int RANGE_TABLE_LIMIT = 100;
+    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    RangeQuery query;
+    string line;
+    cout << "Годы рождения (например: 1998-2002 или 2000; пустая строка — все): ";
+    getline(cin, line);
+    if (!parseRange(line, STUDENT_YEAR_MIN, STUDENT_YEAR_MAX, query.yearFrom, query.yearTo))
+    {
+        cout << "Неверный диапазон годов.\n";
+        return;
+    }
+    cout << "Курсы (например: 4-5 или 3; пустая строка — все): ";
+    getline(cin, line);
+    if (!parseRange(line, STUDENT_COURSE_MIN, STUDENT_COURSE_MAX, query.courseFrom, query.courseTo))
+    {
+        cout << "Неверный диапазон курсов.\n";
+        return;
+    }
+
+    vector<int> found = rangeQuery(query, students, studentCount);
+    if (found.empty())
+    {
+        cout << "Совпадений не найдено.\n";
+        return;
+    }
+    size_t shown = min(found.size(), (size_t)RANGE_TABLE_LIMIT);
+    vector<const Student *> rows(shown);
+    vector<int> numbers(shown);
+    for (size_t i = 0; i < shown; i++)
+    {
+        rows[i] = &students[found[i]];
+        numbers[i] = found[i] + 1;
+    }
+    printStudentRows(rows, numbers);
+    cout << "Найдено студентов: " << found.size();
+    if (shown < found.size())
+        cout << ", показаны первые " << shown;
+    cout << ".\n";
+}
+
+// Building the identity index here also serves the duplicate check of the
+// next add, and catches a file that was appended to itself.
+void reportLoadedDuplicates()
+{
+    int duplicates = buildIdentityIndex(students, studentCount);
+    if (duplicates > 0)
+        cout << "Внимание: точных дубликатов в файле: " << duplicates << " (объединить — пункт 17).\n";
+}
+
+void duplicatesMenu()
+{
+    const int DUPLICATE_SHOW_LIMIT = 20;
+    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    vector<DuplicateGroup> groups = findDuplicateGroups(students, studentCount);
+    if (groups.empty())
+    {
+        cout << "Дубликатов не найдено.\n";
+        return;
+    }
+
+    int exactGroups = 0;
+    int extra = 0;
+    for (int g = 0; g < (int)groups.size(); g++)
+    {
+        exactGroups += groups[g].exact();
+        extra += groups[g].members.size() - 1;
+        if (g >= DUPLICATE_SHOW_LIMIT)
+            continue;
+        cout << "Группа " << g + 1 << (groups[g].exact() ? " (точные дубликаты):\n" : " (похожие записи):\n");
+        for (int index : groups[g].members)
+        {
+            cout << "  ";
+            printStudentBrief(index);
+            cout << "\n";
+        }
+    }
+    if ((int)groups.size() > DUPLICATE_SHOW_LIMIT)
+        cout << "... показаны первые " << DUPLICATE_SHOW_LIMIT << " групп.\n";
+    cout << "Групп: " << groups.size() << " (точных: " << exactGroups << "), лишних записей: " << extra << ".\n";
+
+    cout << "Объединить: 1) только точные дубликаты, 2) все группы; пустая строка — не объединять: ";
+    string line;
+    getline(cin, line);
+    if (line != "1" && line != "2")
+        return;
+
+    vector<vector<int>> merges;
+    for (const DuplicateGroup &group : groups)
+    {
+        if (line == "2")
+            merges.push_back(group.members);
+        else
+            merges.insert(merges.end(), group.exactSets.begin(), group.exactSets.end());
+    }
+    if (merges.empty())
+    {
+        cout << "Точных дубликатов нет, ничего не объединено.\n";
+        return;
+    }
+
+    int removed = 0;
+    for (const vector<int> &members : merges)
+    {
+        int keeper = members[0];
+        Student before = students[keeper];
+        students[keeper].subjects = mergedSubjects(students, members);
+        if (students[keeper].subjects.encoded() != before.subjects.encoded())
+            onStudentUpdated(keeper, before);
+        for (size_t m = 1; m < members.size(); m++)
+        {
+            eraseStudent(members[m], false);
+            removed++;
+        }
+    }
+    compactStudents();
+    cout << "Объединено групп: " << merges.size() << ", удалено записей: " << removed << ".\n";
+    saveToFile();
+}
+
+void bulkEditMenu()
+{
+    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    cout << "Поля: year, course, name, surname, middlename (или год, курс, имя, фамилия, отчество).\n";
+    cout << "Примеры: delete where course = 6\n";
+    cout << "         update course += 1 where course < 6 and year >= 2000\n";
+    cout << "         update surname = \"Иванова\" where surname ^= иванов and name = Мария\n";
+    cout << "Введите команду (пустая строка — отмена): ";
+    string line;
+    getline(cin, line);
+    if (line.empty())
+        return;
+
+    BulkCommand command;
+    string error;
+    if (!parseBulkCommand(line, command, error))
+    {
+        cout << "Ошибка: " << error << ".\n";
+        return;
+    }
+
+    vector<char> selected = bulkSelect(command, students, studentCount);
+    int matched = 0;
+    for (int i = 0; i < studentCount; i++)
+    {
+        if (selected[i] && !studentLive(i))
+            selected[i] = 0;
+        matched += selected[i];
+    }
+    if (matched == 0)
+    {
+        cout << "Под условие не попало ни одной записи.\n";
+        return;
+    }
+
+    if (command.remove)
+    {
+        for (int i = 0; i < studentCount; i++)
+        {
+            if (selected[i])
+                eraseStudent(i, false);
+        }
+        compactStudents();
+        cout << "Удалено записей: " << matched << ".\n";
+        saveToFile();
+        return;
+    }
+
+    vector<Student> updated;
+    updated.reserve(matched);
+    for (int i = 0; i < studentCount; i++)
+    {
+        if (!selected[i])
+            continue;
+        Student student = students[i];
+        bulkApply(command, student);
+        bool valid = command.target == BULK_YEAR     ? isValidYear(student.year)
+                     : command.target == BULK_COURSE ? isValidCourse(student.course)
+                                                     : isValidName(command.text);
+        if (!valid)
+        {
+            cout << "Ошибка: для записи " << i + 1 << " (" << students[i].surname << " " << students[i].name
+                 << ") новое значение недопустимо. Ничего не изменено.\n";
+            return;
+        }
+        updated.push_back(move(student));
+    }
+
+    // Per-record onStudentUpdated() would shift every sort view once per match;
+    // the indexes are rebuilt once instead.
+    size_t next = 0;
+    for (int i = 0; i < studentCount; i++)
+    {
+        if (!selected[i])
+            continue;
+        Student before = move(students[i]);
+        students[i] = move(updated[next++]);
+        recordStudentUpdate(i, before);
+    }
+    onRosterReordered();
+    cout << "Изменено записей: " << matched << ".\n";
+    saveToFile();
+}
+
+void syncChangeLogWithRoster()
+{
+    if (changeLogSynced || lazyStoreActive())
+        return;
+    if (!changeLogOpen() && !openChangeLog(HISTORY_DIR))
+    {
+        cout << "Не удалось открыть журнал изменений " << HISTORY_DIR << ".\n";
+        return;
+    }
+    syncChangeLog(students, studentCount);
+    changeLogSynced = true;
+}
+
+void checkpointChangeLogIfDue()
+{
+    if (changeLogSynced && !lazyStoreActive() && changeCheckpointDue())
+        writeChangeCheckpoint(students, studentCount);
+}
+
+string formatChangeTime(int64_t timestamp)
+{
+    time_t seconds = timestamp / 1000;
+    tm local = *localtime(&seconds);
+    ostringstream out;
+    out << put_time(&local, "%Y-%m-%d %H:%M:%S");
+    return out.str();
+}
+
+void printChangeEvent(const ChangeEvent &event)
+{
+    cout << "#" << event.sequence << "  " << formatChangeTime(event.timestamp) << "  ";
+    if (event.type == CHANGE_RESET)
+    {
+        cout << "журнал сверен с загруженными данными\n";
+        return;
+    }
+
+    Student student;
+    decodeChangeRecord(event.after.empty() ? event.before : event.after, student);
+    if (event.type == CHANGE_INSERT)
+        cout << "добавлен: ";
+    else if (event.type == CHANGE_DELETE)
+        cout << "удалён: ";
+    else
+        cout << "изменён: ";
+    cout << student.surname << " " << student.name << " " << student.middleName;
+    if (event.type == CHANGE_UPDATE)
+    {
+        cout << " (";
+        bool first = true;
+        for (int f = 0; f < CHANGE_FIELDS; f++)
+        {
+            if (!(event.mask & (1 << f)))
+                continue;
+            cout << (first ? "" : ", ") << changeFieldName(f);
+            first = false;
+        }
+        cout << ")";
+    }
+    cout << "\n";
+}
+
+void printChangeState(uint64_t sequence)
+{
+    vector<string> records;
+    if (!changeStateAt(sequence, records))
+    {
+        cout << "Состояние на событие #" << sequence << " недоступно (журнал сжат или событие ещё не записано).\n";
+        return;
+    }
+    cout << "Состояние после события #" << sequence << ": записей " << records.size() << ".\n";
+    if (records.empty())
+        return;
+
+    cout << "Сколько записей показать (0 — все): ";
+    int limit;
+    cin >> limit;
+    size_t shown = limit > 0 ? min(records.size(), (size_t)limit) : records.size();
+
+    vector<Student> decoded(shown);
+    vector<const Student *> rows;
+    vector<int> numbers;
+    for (size_t i = 0; i < shown; i++)
+    {
+        if (!decodeChangeRecord(records[i], decoded[i]))
+            continue;
+        rows.push_back(&decoded[i]);
+        numbers.push_back(i + 1);
+    }
+    printStudentRows(rows, numbers);
+}
+
+void historyMenu()
+{
+    syncChangeLogWithRoster();
+    if (!changeLogOpen())
+        return;
+
+    cout << "\nИстория изменений (последнее событие: #" << changeLogHead() << "):\n";
+    cout << "1) Последние изменения\n";
+    cout << "2) Состояние на момент события\n";
+    cout << "3) Состояние на дату и время\n";
+    cout << "4) Сжать журнал\n";
+    cout << "Выберите пункт: ";
+
+    int historyChoice;
+    cin >> historyChoice;
+
+    if (historyChoice == 1)
+    {
+        cout << "Сколько событий показать: ";
+        int limit;
+        cin >> limit;
+        vector<ChangeEvent> events = recentChanges(max(1, limit));
+        if (events.empty())
+            cout << "Изменений нет.\n";
+        for (const ChangeEvent &event : events)
+            printChangeEvent(event);
+    }
+    else if (historyChoice == 2)
+    {
+        cout << "Введите номер события: ";
+        string input;
+        cin >> input;
+        uint64_t sequence = 0;
+        auto parsed = from_chars(input.data(), input.data() + input.size(), sequence);
+        if (parsed.ec != errc() || parsed.ptr != input.data() + input.size())
+        {
+            cout << "Ошибка: введите число!\n";
+            return;
+        }
+        printChangeState(sequence);
+    }
+    else if (historyChoice == 3)
+    {
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        cout << "Введите дату и время (ГГГГ-ММ-ДД ЧЧ:ММ:СС): ";
+        string input;
+        getline(cin, input);
+        tm local = {};
+        istringstream in(input);
+        in >> get_time(&local, "%Y-%m-%d %H:%M:%S");
+        if (in.fail())
+        {
+            cout << "Ошибка: неверный формат даты.\n";
+            return;
+        }
+        local.tm_isdst = -1;
+        uint64_t sequence = 0;
+        if (!changeSequenceAt((int64_t)mktime(&local) * 1000 + 999, sequence))
+        {
+            cout << "На этот момент данных в журнале нет.\n";
+            return;
+        }
+        printChangeState(sequence);
+    }
+    else if (historyChoice == 4)
+    {
+        writeChangeCheckpoint(students, studentCount);
+        int removed = compactChangeLog(CHANGE_KEEP_CHECKPOINTS);
+        cout << "Журнал сжат: удалено файлов " << removed << ", сохранено контрольных точек не более "
+             << CHANGE_KEEP_CHECKPOINTS << ".\n";
+    }
+    else
+    {
+        cout << "Неверный выбор.\n";
+    }
+}
+
+void stageRoundTrip(const vector<RoundTripRecord> &records)
+{
+    closeLazyStore();
+    resetStringArenas();
+    if ((int)records.size() >= capacity)
+    {
+        delete[] students;
+        capacity = records.size() + 1;
+        students = new Student[capacity];
+    }
+    studentCount = records.size();
+    for (int i = 0; i < studentCount; i++)
+        fillStudentFrom(records[i], students[i]);
+    assignStudentIds();
+    unbindBinaryStore();
+    onRosterReloaded();
+    resetRosterBases();
+}
+
+void collectRoundTrip(vector<RoundTripRecord> &records)
+{
+    records.clear();
+    for (int i = 0; i < studentCount; i++)
+    {
+        if (studentLive(i))
+            records.push_back(roundTripRecordOf(students[i]));
+    }
+}
+
+// Saves the text file, then edits one record twice in lazy mode the way
+// editStudent() does. The second edit undoes the first, so the file must
+// load back unchanged; a lost second edit shows up as a mismatch.
+void saveWithLazyEdits()
+{
+    saveToFile();
+    if (!openLazyStore(FILE1_PATH, false) || lazyRecordCount() == 0)
+        return;
+    Student student = lazyCopy(0);
+    Student before = student;
+    int year = student.year;
+    student.year = year == STUDENT_YEAR_MAX ? year - 1 : year + 1;
+    storeEditedStudent(0, student, before);
+    student.year = year;
+    storeEditedStudent(0, student, before);
+    closeLazyStore();
+}
+
+// Runs in a scratch directory so the real dataset, its snapshot and locks stay untouched.
+bool runRoundTripMode(const vector<size_t> &tiers)
+{
+    const vector<RoundTripCodec> codecs = {
+        {"text", FILE1_PATH.c_str(), saveToFile,
+         [](vector<RoundTripRecord> &records) {
+             loadFromFile();
+             collectRoundTrip(records);
+         }},
+        {"binary", FILE2_PATH.c_str(), saveToBinaryFile,
+         [](vector<RoundTripRecord> &records) {
+             loadFromBinaryFile();
+             collectRoundTrip(records);
+         }},
+        {"lazy-edit", FILE1_PATH.c_str(), saveWithLazyEdits,
+         [](vector<RoundTripRecord> &records) {
+             loadFromFile();
+             collectRoundTrip(records);
+         }},
+        {"snapshot", SNAPSHOT_PATH.c_str(),
+         []() {
+             saveToBinaryFile();
+             flushPendingSnapshot();
+         },
+         [](vector<RoundTripRecord> &records) {
+             loadFromSnapshot();
+             collectRoundTrip(records);
+         }},
+    };
+
+    error_code ec;
+    filesystem::path home = filesystem::current_path();
+    filesystem::path scratch = filesystem::temp_directory_path(ec) /
+                               ("utp-roundtrip-" + to_string(chrono::steady_clock::now().time_since_epoch().count()));
+    filesystem::create_directories(scratch, ec);
+    if (ec)
+    {
+        cout << "Ошибка: не удалось создать временный каталог " << scratch.string() << ".\n";
+        return false;
+    }
+    filesystem::current_path(scratch);
+    cout << "Проверка сохранения и загрузки (seed " << ROUND_TRIP_SEED << ")...\n";
+    vector<RoundTripResult> results = runRoundTrip(codecs, stageRoundTrip, tiers, ROUND_TRIP_SEED);
+    results.push_back(runLegacyFixture(FILE2_PATH.c_str(), codecs[1].load));
+    filesystem::current_path(home);
+    filesystem::remove_all(scratch, ec);
+
+    bool passed = true;
+    vector<vector<string>> rows;
+    for (const RoundTripResult &result : results)
+    {
+        double megabytes = result.bytes / (1024.0 * 1024.0);
+        bool saved = result.saveSeconds > 0;
+        rows.push_back({result.format, to_string(result.records), formatDecimal(megabytes, 2),
+                        saved ? formatDecimal(megabytes / result.saveSeconds, 1) : "—",
+                        saved ? to_string((long long)(result.records / result.saveSeconds)) : "—",
+                        formatDecimal(megabytes / result.loadSeconds, 1),
+                        to_string((long long)(result.records / result.loadSeconds)),
+                        result.problem.empty() ? "совпадает" : result.problem});
+        passed = passed && result.problem.empty();
+    }
+    printTextTable({"Формат", "Записей", "Размер, МБ", "Запись, МБ/с", "Запись, зап/с", "Чтение, МБ/с",
+                    "Чтение, зап/с", "Результат"},
+                   rows);
+    cout << (passed ? "Все форматы сохраняют данные без потерь.\n" : "Обнаружены расхождения.\n");
+    return passed;
+}
+
+string formatDecimal(double value, int precision)
+{
+    ostringstream out;
+    out << fixed << setprecision(precision) << value;
+    return out.str();
+}
+
+void printTextTable(const vector<string> &headers, const vector<vector<string>> &rows)
+{
+    vector<int> colWidths(headers.size());
+    for (size_t j = 0; j < headers.size(); j++)
+    {
+        colWidths[j] = displayWidth(headers[j]);
+        for (const auto &row : rows)
+            colWidths[j] = max(colWidths[j], displayWidth(row[j]));
+    }
+
+    auto printRow = [&](const vector<string> &cells) {
+        vector<vector<string>> wrapped;
+        for (const string &cell : cells)
+            wrapped.push_back({cell});
+        printWrappedRow(wrapped, colWidths);
+    };
+    printSeparatorLine(colWidths);
+    printRow(headers);
+    printSeparatorLine(colWidths);
+    for (const auto &row : rows)
+        printRow(row);
+    printSeparatorLine(colWidths);
+}
+
+void analyticsMenu()
+{
+    cout << "\nГруппировать:\n";
+    cout << "1) По курсу\n";
+    cout << "2) По году рождения (когорты)\n";
+    cout << "Выберите группировку: ";
+    int groupChoice;
+    cin >> groupChoice;
+    if (groupChoice != 1 && groupChoice != 2)
+    {
+        cout << "Неверный выбор.\n";
+        return;
+    }
+
+    int cohortWidth = 1;
+    if (groupChoice == 2)
+    {
+        cout << "Ширина когорты в годах (1-20): ";
+        cin >> cohortWidth;
+        if (!cin || cohortWidth < 1 || cohortWidth > 20)
+        {
+            cin.clear();
+            cout << "Ошибка: ширина когорты должна быть от 1 до 20.\n";
+            return;
+        }
+    }
+    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    cout << "Предмет или его часть (пустая строка — все предметы): ";
+    string filter;
+    getline(cin, filter);
+    filter = toLowerUtf8(filter);
+
+    AnalyticsGrouping grouping = groupChoice == 1 ? GROUP_BY_COURSE : GROUP_BY_COHORT;
+    int records = liveStudentCount();
+    shared_ptr<RosterPin> pin = records >= BACKGROUND_JOB_MIN_RECORDS ? pinRoster() : nullptr;
+    if (pin)
+    {
+        // Metrics are not thread-safe, so the job only measures; the
+        // completion records it on this thread.
+        startBackgroundJob("аналитика оценок", [pin, grouping, cohortWidth, filter, records]() {
+            auto start = chrono::steady_clock::now();
+            auto analytics = make_shared<RosterAnalytics>(analyzeRoster(pin->image().spans(), grouping, cohortWidth));
+            long long ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+            return function<void()>([analytics, grouping, cohortWidth, filter, records, ns] {
+                if (metricsEnabled)
+                    metricRecord(METRIC_ANALYTICS, ns);
+                metricAddRecords(METRIC_ANALYTICS, records);
+                printAnalytics(*analytics, grouping, cohortWidth, filter);
+            });
+        });
+        return;
+    }
+
+    RosterAnalytics analytics;
+    {
+        MetricTimer timer(METRIC_ANALYTICS);
+        metricAddRecords(METRIC_ANALYTICS, records);
+        analytics = analyzeRoster({{students, (size_t)studentCount}}, grouping, cohortWidth);
+    }
+    printAnalytics(analytics, grouping, cohortWidth, filter);
+}
+
+void printAnalytics(const RosterAnalytics &analytics, AnalyticsGrouping grouping, int cohortWidth,
+                    const string &filter)
+{
+    auto groupLabel = [&](int key) {
+        if (grouping == GROUP_BY_COURSE)
+            return "Курс " + to_string(key);
+        if (cohortWidth == 1)
+            return to_string(key) + " г.р.";
+        return to_string(key) + "–" + to_string(key + cohortWidth - 1) + " г.р.";
+    };
+    auto histogramRow = [](const string &label, const GradeHistogram &histogram) {
+        vector<string> row = {label};
+        for (int g = GRADE_MIN; g <= GRADE_MAX; g++)
+            row.push_back(to_string(histogram.counts[g]));
+        row.push_back(to_string(histogram.total()));
+        row.push_back(formatDecimal(histogram.mean(), 2));
+        return row;
+    };
+
+    vector<string> headers = {grouping == GROUP_BY_COURSE ? "Курс" : "Когорта"};
+    for (int g = GRADE_MIN; g <= GRADE_MAX; g++)
+        headers.push_back("«" + to_string(g) + "»");
+    headers.push_back("Всего");
+    headers.push_back("Средняя");
+
+    int shown = 0;
+    for (const SubjectAnalytics &subject : analytics.subjects)
+    {
+        if (!filter.empty() && toLowerUtf8(subject.subject).find(filter) == string::npos)
+            continue;
+        shown++;
+        cout << "\nПредмет: " << subject.subject << "\n";
+        vector<vector<string>> rows;
+        for (const auto &group : subject.groups)
+            rows.push_back(histogramRow(groupLabel(group.first), group.second));
+        rows.push_back(histogramRow("Все", subject.overall));
+        printTextTable(headers, rows);
+    }
+    if (shown == 0)
+        cout << "Оценок по таким предметам нет.\n";
+
+    cout << "\nСредний балл студентов:\n";
+    vector<string> averageHeaders = {headers[0], "Студентов", "Среднее", "Дисперсия", "Ст. откл."};
+    for (double p : AVERAGE_PERCENTILES)
+        averageHeaders.push_back("P" + to_string((int)lround(p * 100)));
+    auto averageRow = [](const string &label, const AverageSummary &summary) {
+        vector<string> row = {label, to_string(summary.count), formatDecimal(summary.mean, 2),
+                              formatDecimal(summary.variance, 3), formatDecimal(sqrt(summary.variance), 3)};
+        for (double value : summary.percentiles)
+            row.push_back(formatDecimal(value, 2));
+        return row;
+    };
+    vector<vector<string>> averageRows;
+    for (const auto &group : analytics.groupAverages)
+        averageRows.push_back(averageRow(groupLabel(group.first), group.second));
+    averageRows.push_back(averageRow("Все", analytics.averages));
+    printTextTable(averageHeaders, averageRows);
+}
+
+void printStudentBrief(int index)
+{
+    const Student &student = students[index];
+    cout << index + 1 << ") #" << student.id << " " << student.surname << " " << student.name << " "
+         << student.middleName << ", " << student.year << " г.р., курс " << student.course;
+}
+
+void ensureNameIndexes()
+{
+    if (!nameIndexesStale)
+        return;
+    rebuildNameIndex(students, studentCount);
+    rebuildSurnameIndex(students, studentCount);
+    nameIndexesStale = false;
+}
+
+void onRosterReloaded()
+{
+    resetSortViews();
+    resetRangeIndex();
+    resetIdentityIndex();
+    versionStoreInvalidate();
+    nameIndexesStale = true;
+    changeLogSynced = false;
+}
+
+void onRosterReordered()
+{
+    for (int i = 0; i < studentCount; i++)
+    {
+        if (studentLive(i))
+            moveStudentId(students[i].id, i);
+    }
+    if (!nameIndexesStale)
+    {
+        nameIndexReorder(students, studentCount);
+        rebuildSurnameIndex(students, studentCount);
+    }
+    resetSortViews();
+    resetRangeIndex();
+    resetIdentityIndex();
+    versionStoreInvalidate();
+}
+
+void onStudentInserted(int index)
+{
+    binaryStoreMarkDirty(students[index].id);
+    if (!applyingExternalChange)
+        trackRosterInsert(students[index].id);
+    if (changeLogSynced)
+        appendChange(nullptr, &students[index]);
+    if (!nameIndexesStale)
+    {
+        nameIndexInsert(index, students[index]);
+        surnameIndexInsert(index, students[index]);
+    }
+    sortViewsInsert(index, students);
+    rangeIndexInsert(index, students[index]);
+    identityIndexInsert(index, students[index]);
+    versionStoreMarkDirty(index);
+}
+
+// The bookkeeping half of onStudentUpdated(): what has to be written out and
+// logged, without touching the in-memory indexes.
+void recordStudentUpdate(int index, const Student &before)
+{
+    binaryStoreMarkDirty(students[index].id);
+    if (!applyingExternalChange)
+        trackRosterChange(students[index].id, before);
+    if (changeLogSynced)
+        appendChange(&before, &students[index]);
+}
+
+void onStudentUpdated(int index, const Student &before)
+{
+    recordStudentUpdate(index, before);
+    if (!nameIndexesStale)
+    {
+        nameIndexUpdate(index, students[index]);
+        surnameIndexUpdate(index, before, students[index]);
+    }
+    sortViewsUpdate(index, students);
+    rangeIndexUpdate(index, before, students[index]);
+    identityIndexUpdate(index, before, students[index]);
+    versionStoreMarkDirty(index);
+}
+
+// reindex = false leaves the position indexes alone for callers that compact
+// right after; the reorder rebuilds them once instead of per record.
+void onStudentErased(int index, bool reindex)
+{
+    binaryStoreMarkErased(students[index].id);
+    if (!applyingExternalChange)
+        trackRosterChange(students[index].id, students[index]);
+    if (changeLogSynced)
+        appendChange(&students[index], nullptr);
+    if (!reindex)
+        return;
+    if (!nameIndexesStale)
+    {
+        nameIndexErase(index);
+        surnameIndexErase(index, students[index]);
+    }
+    sortViewsErase(index);
+    rangeIndexErase(index, students[index]);
+    identityIndexErase(index, students[index]);
+    versionStoreMarkDirty(index);
+}
+
+int selectStudent(const string &action)
+{
+    const int SELECT_TABLE_LIMIT = 100;
+    const int SELECT_MATCH_LIMIT = 20;
+
+    if (lazyStoreActive())
+        printLazyPages();
+    else if (liveStudentCount() <= SELECT_TABLE_LIMIT)
+        printArray();
+
+    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    while (true)
+    {
+        cout << "Введите номер студента для " << action;
+        if (!lazyStoreActive())
+            cout << ", #ID или начало фамилии (например: Сол или Сол Ил)";
+        cout << ", пустая строка — отмена: ";
+
+        string input;
+        if (!getline(cin, input) || input.empty())
+            return 0;
+        if (isNumber(input))
+            return input.size() <= 9 ? stoi(input) : -1;
+        if (input[0] == '#' && !lazyStoreActive())
+        {
+            string idText = input.substr(1);
+            int position = isNumber(idText) && idText.size() <= 19 ? positionOfStudentId(stoull(idText)) : -1;
+            if (position >= 0)
+                return position + 1;
+            cout << "Студент с таким ID не найден.\n";
+            continue;
+        }
+        if (lazyStoreActive())
+        {
+            cout << "Ошибка: введите число!\n";
+            continue;
+        }
+
+        ensureNameIndexes();
+        vector<int> matches = surnamePrefixLookup(input, SELECT_MATCH_LIMIT + 1);
+        if (matches.empty())
+        {
+            cout << "Совпадений не найдено.\n";
+            continue;
+        }
+        if (matches.size() == 1)
+        {
+            cout << "Найден: ";
+            printStudentBrief(matches[0]);
+            cout << "\n";
+            return matches[0] + 1;
+        }
+
+        for (int i = 0; i < (int)matches.size() && i < SELECT_MATCH_LIMIT; i++)
+        {
+            printStudentBrief(matches[i]);
+            cout << "\n";
+        }
+        if ((int)matches.size() > SELECT_MATCH_LIMIT)
+            cout << "... показаны первые " << SELECT_MATCH_LIMIT << " совпадений, уточните запрос.\n";
+    }
+}
+
+void sortStudentsByYear()
+{
+    sortStudents(1);
+}
+
+void sortStudents(int sortBy, bool ascending)
+{
+    if (tombstoneCount > 0)
+        compactStudents();
+    if (sortBy < SORT_YEAR || sortBy >= SORT_FIELD_COUNT)
+    {
+        cout << "Неверный параметр сортировки.\n";
+        return;
+    }
+    if (studentCount <= 1)
+        return;
+
+    vector<int> order = sortPermutation({{(SortField)sortBy, ascending}}, students, studentCount);
+    Student *sorted = new Student[capacity];
+    for (int i = 0; i < studentCount; i++)
+        sorted[i] = move(students[order[i]]);
+    delete[] students;
+    students = sorted;
+    onRosterReordered();
+}
+
+bool checkAvailability()
+{
+    if (studentCount + 1 > capacity)
+        return expandArray();
+    return true;
+}
+
+bool addStudentToArray(const Student &student)
+{
+    int existing = findIdentity(student, students, studentCount);
+    if (existing >= 0)
+    {
+        cout << "Такой студент уже есть: ";
+        printStudentBrief(existing);
+        cout << "\nДобавить ещё одну запись с теми же ФИО и годом рождения?\n";
+        if (!askPermission1())
+        {
+            cout << "Студент не добавлен.\n";
+            return false;
+        }
+    }
+    if (!checkAvailability())
+        return false;
+    students[studentCount] = student;
+    students[studentCount].id = allocateStudentId(studentCount);
+    studentCount++;
+    onStudentInserted(studentCount - 1);
+    cout << "Студент успешно добавлен.\n";
+    return true;
+}
+
+void deleteStudent(int index)
+{
+    if (index < 0 || index >= studentCount || !studentLive(index))
+    {
+        cout << "Неверный номер студента.\n";
+        return;
+    }
+    eraseStudent(index, true);
+    if (tombstoneCount > studentCount * TOMBSTONE_COMPACT_RATIO)
+        compactStudents();
+
+    cout << "Студент удалён.\n";
+    saveToFile();
+}
+
+// Leaves a tombstone in place of a live record.
+void eraseStudent(int index, bool reindex)
+{
+    onStudentErased(index, reindex);
+    releaseStudentId(students[index].id);
+    students[index] = Student();
+    tombstoneCount++;
+}
+
+bool studentLive(int index)
+{
+    return students[index].id != INVALID_STUDENT_ID;
+}
+
+int liveStudentCount()
+{
+    return studentCount - tombstoneCount;
+}
+
+void assignStudentIds()
+{
+    resetStudentIds();
+    tombstoneCount = 0;
+    for (int i = 0; i < studentCount; i++)
+        students[i].id = allocateStudentId(i);
+}
+
+void compactStudents()
+{
+    int live = 0;
+    for (int i = 0; i < studentCount; i++)
+    {
+        if (!studentLive(i))
+            continue;
+        if (live != i)
+        {
+            students[live] = move(students[i]);
+            students[i] = Student();
+        }
+        live++;
+    }
+    studentCount = live;
+    tombstoneCount = 0;
+    onRosterReordered();
+}
+
+bool expandArray()
+{
+    MetricTimer timer(METRIC_EXPAND);
+    int newCapacity = capacity * 2;
+    if (memoryBudget != 0)
+    {
+        size_t needed = currentMemory().total() + (size_t)newCapacity * sizeof(Student);
+        if (!memoryBudgetAllows(needed))
+        {
+            cout << "Ошибка: для " << newCapacity << " записей нужно около " << formatBytes(needed)
+                 << ", бюджет памяти " << formatBytes(memoryBudget) << ".\n";
+            return false;
+        }
+    }
+    Student *newStudents = new Student[newCapacity];
+    for (int i = 0; i < capacity; i++)
+        newStudents[i] = move(students[i]);
+
+    delete[] students;
+    students = newStudents;
+    capacity = newCapacity;
+    metricAddReallocation((long long)newCapacity * sizeof(Student));
+
+    cout << "Размер массива увеличен: " << capacity << "\n";
+    return true;
+}
+
+void reserveStudents(int count)
+{
+    if (count <= capacity)
+        return;
+    delete[] students;
+    students = new Student[count];
+    capacity = count;
+    metricAddReallocation((long long)count * sizeof(Student));
+}
+
+MemoryUsage currentMemory()
+{
+    return measureMemory((size_t)capacity * sizeof(Student));
+}
+
+// The file buffer is kept as the string arena; subject blocks and names too
+// long to store inline add roughly half as much again.
+size_t rosterLoadEstimate(long long records, long long bytes)
+{
+    return (size_t)records * sizeof(Student) + bytes + bytes / 2;
+}
+
+bool degradeIfOverBudget(const string &path, bool binary, size_t needed)
+{
+    if (memoryBudgetAllows(needed))
+        return false;
+    cout << "Полная загрузка " << path << " требует около " << formatBytes(needed) << " при бюджете "
+         << formatBytes(memoryBudget) << ", файл открывается в ленивом режиме.\n";
+    if (!openLazyRoster(path, binary))
+        cout << "Список не загружен.\n";
+    return true;
+}
+
+// Drops the in-memory roster once a lazy store serves the records instead.
+void releaseRosterForLazyStore()
+{
+    unwatchRosterFile();
+    delete[] students;
+    capacity = 10;
+    students = new Student[capacity];
+    studentCount = 0;
+    tombstoneCount = 0;
+    unbindBinaryStore();
+    onRosterReloaded();
+    resetRosterBases();
+    resetStudentIds();
+}
+
+bool openLazyRoster(const string &path, bool binary)
+{
+    if (!openLazyStore(path, binary))
+        return false;
+    releaseRosterForLazyStore();
+    resetStringArenas();
+    cout << "Открыто в ленивом режиме: " << lazyRecordCount() << " записей.\n";
+    return true;
+}
+
+void editStudent(int index)
+{
+    int total = lazyStoreActive() ? lazyRecordCount() : studentCount;
+    if (index < 1 || index > total || (!lazyStoreActive() && !studentLive(index - 1)))
+    {
+        cout << "Неверный номер студента.\n";
+        return;
+    }
+
+    index--;
+    Student student = lazyStoreActive() ? lazyCopy(index) : students[index];
+    Student before = student;
+
+    while (true)
+    {
+        cout << "\nЧто хотите изменить?\n";
+        cout << "1) Год рождения\n";
+        cout << "2) Курс\n";
+        cout << "3) Имя\n";
+        cout << "4) Фамилия\n";
+        cout << "5) Отчество\n";
+        cout << "6) Предметы и оценки\n";
+        cout << "7) Выход\n";
+        cout << "Выберите пункт: ";
 
         int editChoice;
         cin >> editChoice;
@@ -890,8 +2215,8 @@ void editStudent(int index)
                 break;
             }
 
-            students[index].year = stoi(input);
-            saveToFile();
+            student.year = stoi(input);
+            storeEditedStudent(index, student, before);
             cout << "Год рождения обновлён.\n";
             break;
         }
@@ -932,8 +2257,8 @@ void editStudent(int index)
                 break;
             }
 
-            students[index].course = stoi(input);
-            saveToFile();
+            student.course = stoi(input);
+            storeEditedStudent(index, student, before);
             cout << "Курс обновлён.\n";
             break;
         }
@@ -953,8 +2278,8 @@ void editStudent(int index)
             if (!askPermission1())
                 break;
 
-            students[index].name = name;
-            saveToFile();
+            student.name = name;
+            storeEditedStudent(index, student, before);
             cout << "Имя обновлено.\n";
             break;
         }
@@ -974,8 +2299,8 @@ void editStudent(int index)
             if (!askPermission1())
                 break;
 
-            students[index].surname = surname;
-            saveToFile();
+            student.surname = surname;
+            storeEditedStudent(index, student, before);
             cout << "Фамилия обновлена.\n";
             break;
         }
@@ -995,212 +2320,281 @@ void editStudent(int index)
             if (!askPermission1())
                 break;
 
-            students[index].middleName = middle;
-            saveToFile();
+            student.middleName = middle;
+            storeEditedStudent(index, student, before);
             cout << "Отчество обновлено.\n";
             break;
         }
 
         case 6:
         {
-            Student backup = students[index];
-
-            for (int i = 0; i < 3; i++)
-            {
-                while (true)
-                {
-                    cout << "Введите предмет " << i + 1 << " (только русские или английские буквы): ";
-                    getline(cin, students[index].subjects[i]);
-                    if (isValidSubject(students[index].subjects[i]))
-                        break;
-                    cout << "Ошибка: название предмета может содержать только русские или английские буквы.\n";
-                }
-
-                while (true)
-                {
-                    cout << "Введите 3 оценки (1–5, через запятую, например: 5,4,3): ";
-                    getline(cin, students[index].grades[i]);
-
-                    if (checkGrades(students[index].grades[i]))
-                        break;
-
-                    cout << "Ошибка: введите ровно 3 оценки (числа 1–5 через запятую).\n";
-                }
-            }
+            Student backup = student;
+            student.subjects = inputSubjects();
 
             if (!askPermission1())
             {
-                students[index] = backup;
+                student = backup;
                 cout << "Отменено.\n";
                 break;
             }
 
-            saveToFile();
+            storeEditedStudent(index, student, before);
             cout << "Предметы и оценки обновлены.\n";
             break;
         }
 
-        case 7:
-        {
-            bool toMenu = askPermission2();
-            if (toMenu)
-                return;
-            else
-                break;
-        }
+        case 7:
+        {
+            bool toMenu = askPermission2();
+            if (toMenu)
+                return;
+            else
+                break;
+        }
+
+        default:
+            cout << "Неверный пункт.\n";
+        }
+    }
+}
+
+// editStudent() works on a copy: saving the lazy store reopens it, so a
+// reference into its dirty set would not survive persistStudents().
+void storeEditedStudent(int index, const Student &student, Student &before)
+{
+    if (lazyStoreActive())
+        lazyEditable(index) = student;
+    else
+    {
+        students[index] = student;
+        onStudentUpdated(index, before);
+    }
+    before = student;
+    persistStudents();
+}
+
+void persistStudents()
+{
+    if (!lazyStoreActive())
+    {
+        saveToFile();
+        return;
+    }
+    FileLock lock(lazyStoreBinary() ? FILE2_PATH : FILE1_PATH, FILE_LOCK_EXCLUSIVE);
+    if (saveLazyStore())
+        cout << (lazyStoreBinary() ? "Бинарный файл сохранён.\n" : "Текстовый файл сохранён.\n");
+}
+
+bool materializeLazyStore()
+{
+    if (lazyStoreSnapshot())
+    {
+        closeLazyStore();
+        if (!loadFromSnapshot())
+            loadDatasetSource();
+        return !lazyStoreActive();
+    }
+    bool binary = lazyStoreBinary();
+    {
+        FileLock lock(binary ? FILE2_PATH : FILE1_PATH, FILE_LOCK_EXCLUSIVE);
+        if (!saveLazyStore())
+            return false;
+    }
+    closeLazyStore();
+    if (binary)
+        loadFromBinaryFile();
+    else
+        loadFromFile();
+    if (lazyStoreActive())
+    {
+        cout << "Операция требует загрузки всего списка, а он не помещается в бюджет памяти.\n";
+        return false;
+    }
+    return true;
+}
+
+void writeTextStudent(ostream &out, const Student &student)
+{
+    out << student.year << "|"
+        << student.course << "|"
+        << student.name << "|"
+        << student.surname << "|"
+        << student.middleName;
+    for (int j = 0; j < student.subjects.size(); j++)
+        out << "|" << student.subjects.subject(j) << "|" << student.subjects.gradesText(j);
+    out << "\n";
+}
+
+// The whole field must be a number within [minValue, maxValue]; "2000x" or "0" rejects the line.
+static bool parseTextNumber(string_view field, int minValue, int maxValue, int &value)
+{
+    auto parsed = from_chars(field.data(), field.data() + field.size(), value);
+    return parsed.ec == errc() && parsed.ptr == field.data() + field.size() && value >= minValue && value <= maxValue;
+}
+
+// Leaves the subject list encoded in builder, so the caller decides where the block lives.
+bool parseTextFields(string_view line, Student &student, SubjectListBuilder &builder)
+{
+    string_view fields[TEXT_FIXED_FIELDS];
+    size_t start = 0;
+    for (int count = 0; count < TEXT_FIXED_FIELDS; count++)
+    {
+        size_t end = line.find('|', start);
+        if (end == string_view::npos && count + 1 < TEXT_FIXED_FIELDS)
+            return false;
+        fields[count] = line.substr(start, end == string_view::npos ? string_view::npos : end - start);
+        start = end == string_view::npos ? line.size() + 1 : end + 1;
+    }
+
+    string_view year = fields[0];
+    string_view course = fields[1];
+    if (!parseTextNumber(year, STUDENT_YEAR_MIN, STUDENT_YEAR_MAX, student.year) ||
+        !parseTextNumber(course, STUDENT_COURSE_MIN, STUDENT_COURSE_MAX, student.course))
+        return false;
+    student.name = fields[2];
+    student.surname = fields[3];
+    student.middleName = fields[4];
 
-        default:
-            cout << "Неверный пункт.\n";
-        }
+    builder.clear();
+    while (start <= line.size())
+    {
+        size_t subjectEnd = line.find('|', start);
+        if (subjectEnd == string_view::npos)
+            return false;
+        size_t gradesEnd = line.find('|', subjectEnd + 1);
+        string_view subject = line.substr(start, subjectEnd - start);
+        string_view grades = line.substr(subjectEnd + 1, gradesEnd == string_view::npos ? string_view::npos
+                                                                                         : gradesEnd - subjectEnd - 1);
+        if (!(subject.empty() && grades.empty()) && !builder.add(subject, grades))
+            return false;
+        start = gradesEnd == string_view::npos ? line.size() + 1 : gradesEnd + 1;
     }
+    return true;
+}
+
+bool parseTextStudent(string_view line, Student &student)
+{
+    static SubjectListBuilder builder;
+    if (!parseTextFields(line, student, builder))
+        return false;
+    student.subjects = builder.build();
+    return true;
 }
 
 void saveToFile()
 {
+    MetricTimer timer(METRIC_SAVE_TEXT);
+    FileLock lock(FILE1_PATH, FILE_LOCK_EXCLUSIVE);
+    RosterVersion current = observeRoster(FILE1_PATH, false);
+    if (rosterBaseStale(current))
+        mergeStaleRoster(current, false);
+    uint64_t generation = nextRosterGeneration(current);
     ofstream fout(FILE1_PATH);
     if (!fout)
     {
         cout << "Ошибка: не удалось открыть файл для записи.\n";
         return;
     }
+    fout << TEXT_GENERATION_PREFIX << generation << "\n" << TEXT_FORMAT_PREFIX << TEXT_FORMAT_VERSION << "\n";
     for (int i = 0; i < studentCount; i++)
     {
-        fout << students[i].year << "|"
-             << students[i].course << "|"
-             << students[i].name << "|"
-             << students[i].surname << "|"
-             << students[i].middleName << "|";
-        for (int j = 0; j < 3; j++)
-        {
-            fout << students[i].subjects[j] << "|" << students[i].grades[j];
-            if (j != 2)
-                fout << "|";
-        }
-        fout << "\n";
+        if (studentLive(i))
+            writeTextStudent(fout, students[i]);
     }
+    metricAddRecords(METRIC_SAVE_TEXT, liveStudentCount());
+    metricAddBytes(METRIC_SAVE_TEXT, fout.tellp());
     fout.close();
+    setRosterBase(observeRosterFile(FILE1_PATH, generation));
+    snapshotPending = true;
+    snapshotPendingBinary = false;
     cout << "Текстовый файл сохранён.\n";
 }
 
 void loadFromFile()
 {
-    ifstream fin(FILE1_PATH);
-    if (!fin)
+    MetricTimer timer(METRIC_LOAD_TEXT);
+    closeLazyStore();
+    FileLock lock(FILE1_PATH, FILE_LOCK_SHARED);
+    error_code ec;
+    uintmax_t fileBytes = filesystem::file_size(FILE1_PATH, ec);
+    if (!ec && degradeIfOverBudget(FILE1_PATH, false, fileBytes))
+        return;
+    vector<char> buffer;
+    if (!readWholeFile(FILE1_PATH, buffer))
     {
         cout << "Ошибка: текстовый файл не найден.\n";
         return;
     }
+    long long bytes = buffer.size();
+    int lines = 1;
+    for (const char *q = buffer.data(); (q = (const char *)memchr(q, '\n', buffer.data() + bytes - q)); q++)
+        lines++;
+    if (degradeIfOverBudget(FILE1_PATH, false, rosterLoadEstimate(lines, bytes)))
+        return;
+    if (!textFormatSupported(string_view(buffer.data(), bytes)))
+    {
+        cout << "Ошибка: текстовый файл записан в неизвестной версии формата.\n";
+        return;
+    }
+    resetStringArenas();
+    const char *p = adoptLoadBuffer(move(buffer));
+    const char *last = p + bytes;
+    reserveStudents(lines);
     studentCount = 0;
-    string line;
-    while (getline(fin, line))
+    uint64_t generation = 0;
+    while (p < last)
     {
-        if (line.empty())
+        const char *newline = (const char *)memchr(p, '\n', last - p);
+        string_view line(p, (newline ? newline : last) - p);
+        p = newline ? newline + 1 : last;
+        if (line.empty() || parseTextGeneration(line, generation))
             continue;
 
-        vector<string> fields;
-        if (!splitLine(line, '|', fields, 11))
+        if (!parseTextStudent(line, students[studentCount]))
         {
             cout << "Ошибка: неверный формат строки в файле.\n";
             continue;
         }
 
-        students[studentCount].year = stoi(fields[0]);
-        students[studentCount].course = stoi(fields[1]);
-        students[studentCount].name = fields[2];
-        students[studentCount].surname = fields[3];
-        students[studentCount].middleName = fields[4];
-        students[studentCount].subjects[0] = fields[5];
-        students[studentCount].grades[0] = fields[6];
-        students[studentCount].subjects[1] = fields[7];
-        students[studentCount].grades[1] = fields[8];
-        students[studentCount].subjects[2] = fields[9];
-        students[studentCount].grades[2] = fields[10];
-
         studentCount++;
-        if (studentCount >= capacity)
-            expandArray();
+        if (studentCount >= capacity && !expandArray())
+            break;
     }
-    fin.close();
+    metricAddRecords(METRIC_LOAD_TEXT, studentCount);
+    metricAddBytes(METRIC_LOAD_TEXT, bytes);
+    assignStudentIds();
+    unbindBinaryStore();
+    onRosterReloaded();
     sortStudentsByYear();
+    resetRosterBases();
+    RosterVersion loaded = observeRosterFile(FILE1_PATH, generation);
+    setRosterBase(loaded);
+    watchLoadedRoster(loaded, false);
+    refreshSnapshot(FILE1_PATH, false);
     cout << "Текстовый файл загружен.\n";
-}
-
-bool splitLine(const string &line, char delimiter, vector<string> &fields, int expectedFields)
-{
-    fields.clear();
-    string current;
-    for (size_t i = 0; i < line.size(); i++)
-    {
-        char c = line[i];
-        if (c == delimiter)
-        {
-            fields.push_back(current);
-            current.clear();
-        }
-        else
-        {
-            current.push_back(c);
-        }
-    }
-    fields.push_back(current);
-    return (int)fields.size() == expectedFields;
-}
-
-bool parseGradesSumCount(const string &grades, int &sum, int &count)
-{
-    sum = 0;
-    count = 0;
-    string current;
-    for (size_t i = 0; i < grades.size(); i++)
-    {
-        char c = grades[i];
-        if (isdigit(c))
-        {
-            current.push_back(c);
-            continue;
-        }
-        if (c == ',')
-        {
-            if (current.empty())
-                return false;
-            int value = stoi(current);
-            sum += value;
-            count++;
-            current.clear();
-            continue;
-        }
-        return false;
-    }
-    if (current.empty())
-        return false;
-    sum += stoi(current);
-    count++;
-    return count > 0;
+    reportLoadedDuplicates();
 }
 
 double calcAverageGrade(const Student &student)
 {
     int totalSum = 0;
     int totalCount = 0;
-    for (int i = 0; i < 3; i++)
+    for (int i = 0; i < student.subjects.size(); i++)
     {
-        int sum = 0;
-        int count = 0;
-        if (parseGradesSumCount(student.grades[i], sum, count))
-        {
-            totalSum += sum;
-            totalCount += count;
-        }
+        GradeSpan grades = student.subjects.grades(i);
+        for (size_t g = 0; g < grades.size; g++)
+            totalSum += grades.data[g];
+        totalCount += grades.size;
     }
     if (totalCount == 0)
         return 0.0;
-    return static_cast<double>(totalSum) / static_cast<double>(totalCount);
+    return (double)totalSum / totalCount;
 }
 
-string toLowerUtf8(const string &s)
+string toLowerUtf8(string_view s)
 {
     wstring_convert<codecvt_utf8<wchar_t>> conv;
-    wstring ws = conv.from_bytes(s);
+    wstring ws = conv.from_bytes(s.data(), s.data() + s.size());
 
     for (auto &c : ws)
         c = towlower(c);
@@ -1249,101 +2643,600 @@ bool askPermission2()
     return answer == 'm';
 }
 
-void saveToBinaryFile()
+bool writeBinaryStudent(ostream &out, const Student &student)
 {
-    ofstream fout(FILE2_PATH, ios::binary);
-    if (!fout)
+    if (student.subjects.size() > LEGACY_BINARY_SUBJECTS)
+        return false;
+    out.write((char *)&student.year, sizeof(student.year));
+    out.write((char *)&student.course, sizeof(student.course));
+
+    int nameLen = student.name.length();
+    out.write((char *)&nameLen, sizeof(nameLen));
+    out.write(student.name.data(), nameLen);
+
+    int surnameLen = student.surname.length();
+    out.write((char *)&surnameLen, sizeof(surnameLen));
+    out.write(student.surname.data(), surnameLen);
+
+    int middleNameLen = student.middleName.length();
+    out.write((char *)&middleNameLen, sizeof(middleNameLen));
+    out.write(student.middleName.data(), middleNameLen);
+
+    for (int j = 0; j < LEGACY_BINARY_SUBJECTS; j++)
     {
-        cout << "Ошибка записи бинарного файла.\n";
+        string_view subject = j < student.subjects.size() ? student.subjects.subject(j) : string_view();
+        int subjectLen = subject.size();
+        out.write((char *)&subjectLen, sizeof(subjectLen));
+        out.write(subject.data(), subjectLen);
+
+        string grades = j < student.subjects.size() ? student.subjects.gradesText(j) : string();
+        int gradeLen = grades.size();
+        out.write((char *)&gradeLen, sizeof(gradeLen));
+        out.write(grades.data(), gradeLen);
+    }
+    return true;
+}
+
+static bool takeBinaryField(const char *&p, const char *end, string_view &field)
+{
+    int len = 0;
+    if (end - p < (ptrdiff_t)sizeof(len))
+        return false;
+    memcpy(&len, p, sizeof(len));
+    p += sizeof(len);
+    if (len < 0 || end - p < len)
+        return false;
+    field = string_view(p, len);
+    p += len;
+    return true;
+}
+
+// Reads one legacy record up to its subject pairs; false only when the record is truncated,
+// so a caller can skip a record whose grades do not parse and carry on with the next one.
+static bool takeBinaryStudent(const char *&p, const char *end, Student &student, string_view *pairs)
+{
+    if (end - p < (ptrdiff_t)(2 * sizeof(int)))
+        return false;
+    memcpy(&student.year, p, sizeof(int));
+    memcpy(&student.course, p + sizeof(int), sizeof(int));
+    p += 2 * sizeof(int);
+    string_view names[3];
+    for (string_view &field : names)
+    {
+        if (!takeBinaryField(p, end, field))
+            return false;
+    }
+    for (int f = 0; f < 2 * LEGACY_BINARY_SUBJECTS; f++)
+    {
+        if (!takeBinaryField(p, end, pairs[f]))
+            return false;
+    }
+    student.name = names[0];
+    student.surname = names[1];
+    student.middleName = names[2];
+    return true;
+}
+
+bool decodeBinaryFields(const char *&p, const char *end, Student &student, SubjectListBuilder &builder)
+{
+    string_view pairs[2 * LEGACY_BINARY_SUBJECTS];
+    return takeBinaryStudent(p, end, student, pairs) && encodeLegacySubjects(pairs, LEGACY_BINARY_SUBJECTS, builder);
+}
+
+bool decodeBinaryStudent(const char *&p, const char *end, Student &student)
+{
+    string_view pairs[2 * LEGACY_BINARY_SUBJECTS];
+    return takeBinaryStudent(p, end, student, pairs) &&
+           buildLegacySubjects(pairs, LEGACY_BINARY_SUBJECTS, student.subjects);
+}
+
+bool readWholeFile(const string &path, vector<char> &buffer)
+{
+    ifstream fin(path, ios::binary | ios::ate);
+    if (!fin)
+        return false;
+    buffer.resize(fin.tellg());
+    fin.seekg(0);
+    fin.read(buffer.data(), buffer.size());
+    return (bool)fin;
+}
+
+bool parseTextGeneration(string_view line, uint64_t &generation)
+{
+    if (line.empty() || line[0] != '#')
+        return false;
+    if (line.substr(0, TEXT_GENERATION_PREFIX.size()) == TEXT_GENERATION_PREFIX)
+        from_chars(line.data() + TEXT_GENERATION_PREFIX.size(), line.data() + line.size(), generation);
+    return true;
+}
+
+// Scans the leading '#' lines; a file without a #format line predates it and is version 1.
+bool textFormatSupported(string_view text)
+{
+    while (!text.empty() && text[0] == '#')
+    {
+        size_t newline = text.find('\n');
+        string_view line = text.substr(0, newline);
+        if (line.substr(0, TEXT_FORMAT_PREFIX.size()) == TEXT_FORMAT_PREFIX)
+        {
+            int version = 0;
+            const char *end = line.data() + line.size();
+            auto parsed = from_chars(line.data() + TEXT_FORMAT_PREFIX.size(), end, version);
+            return parsed.ec == errc() && parsed.ptr == end && version >= 1 && version <= TEXT_FORMAT_VERSION;
+        }
+        if (newline == string_view::npos)
+            break;
+        text.remove_prefix(newline + 1);
+    }
+    return true;
+}
+
+bool textFileFormatSupported(const string &path)
+{
+    ifstream fin(path, ios::binary);
+    string header;
+    string line;
+    while (fin.peek() == '#' && getline(fin, line))
+        header += line + "\n";
+    return textFormatSupported(header);
+}
+
+uint64_t textFileGeneration(const string &path)
+{
+    ifstream fin(path, ios::binary);
+    string line;
+    uint64_t generation = 0;
+    if (getline(fin, line))
+        parseTextGeneration(line, generation);
+    return generation;
+}
+
+RosterVersion observeRoster(const string &path, bool binary)
+{
+    return observeRosterFile(path, binary ? binaryStoreGeneration(path) : textFileGeneration(path));
+}
+
+bool readRosterFile(const string &path, bool binary, vector<Student> &records)
+{
+    vector<char> buffer;
+    if (!readWholeFile(path, buffer))
+        return false;
+    const char *p = buffer.data();
+    const char *last = p + buffer.size();
+    records.clear();
+    if (!binary)
+    {
+        if (!textFormatSupported(string_view(p, buffer.size())))
+            return false;
+        uint64_t generation = 0;
+        while (p < last)
+        {
+            const char *newline = (const char *)memchr(p, '\n', last - p);
+            string_view line(p, (newline ? newline : last) - p);
+            p = newline ? newline + 1 : last;
+            Student student;
+            if (line.empty() || parseTextGeneration(line, generation) || !parseTextStudent(line, student))
+                continue;
+            records.push_back(student);
+        }
+    }
+    else if (isBinaryStore(p, buffer.size()))
+    {
+        vector<int> slots;
+        records.resize(binaryStoreLiveCount(p, buffer.size()));
+        if (!decodeBinaryStore(p, buffer.size(), records.data(), records.size(), slots))
+            return false;
+    }
+    else
+    {
+        int count = 0;
+        if (buffer.size() >= sizeof(count))
+            memcpy(&count, p, sizeof(count));
+        p += min(buffer.size(), sizeof(count));
+        Student student;
+        while ((int)records.size() < count && decodeBinaryStudent(p, last, student))
+            records.push_back(student);
+    }
+    for (Student &student : records)
+        ownStudentFields(student);
+    return true;
+}
+
+void replaceRoster(vector<Student> &records)
+{
+    if ((int)records.size() >= capacity)
+    {
+        delete[] students;
+        capacity = records.size() + 1;
+        students = new Student[capacity];
+    }
+    for (size_t i = 0; i < records.size(); i++)
+        students[i] = move(records[i]);
+    studentCount = records.size();
+    assignStudentIds();
+    unbindBinaryStore();
+    onRosterReloaded();
+    sortStudentsByYear();
+}
+
+void mergeStaleRoster(const RosterVersion &current, bool binary)
+{
+    if (current.size < 0)
+        return;
+    vector<Student> records;
+    if (!readRosterFile(current.path, binary, records))
+    {
+        cout << "Предупреждение: не удалось прочитать " << current.path << " для объединения изменений.\n";
         return;
     }
-    fout.write((char *)&studentCount, sizeof(studentCount));
-    for (int i = 0; i < studentCount; i++)
+
+    RosterMergeStats stats;
+    mergeRoster(current.path, records, students, stats);
+    replaceRoster(records);
+    resetRosterBases();
+    cout << "Файл " << current.path << " был изменён другим процессом; изменения объединены (ваших правок применено: "
+         << stats.applied << ").\n";
+    for (const Student &student : stats.conflicts)
     {
-        fout.write((char *)&students[i].year, sizeof(students[i].year));
-        fout.write((char *)&students[i].course, sizeof(students[i].course));
+        cout << "Конфликт: запись " << student.surname << " " << student.name << " " << student.middleName
+             << " изменена или удалена другим процессом, ваша правка не применена.\n";
+    }
+}
 
-        int nameLen = students[i].name.length();
-        fout.write((char *)&nameLen, sizeof(nameLen));
-        fout.write(students[i].name.c_str(), nameLen);
+void watchLoadedRoster(const RosterVersion &version, bool binary)
+{
+    if (watchEnabled)
+        watchRosterFile(version, binary);
+}
 
-        int surnameLen = students[i].surname.length();
-        fout.write((char *)&surnameLen, sizeof(surnameLen));
-        fout.write(students[i].surname.c_str(), surnameLen);
+void applyRosterDeltas()
+{
+    RosterDelta delta;
+    while (takeRosterDelta(delta))
+    {
+        if (lazyStoreActive() || !rosterBaseStale(delta.version))
+            continue;
+        if (delta.rescan)
+            cout << "\nФайл " << delta.version.path << " изменён другим процессом. Изменения будут объединены при "
+                 << "сохранении; чтобы увидеть их сейчас, загрузите файл заново (пункт 6).\n";
+        else if (rosterBaseIs(delta.from))
+            applyExternalDelta(delta);
+    }
+}
 
-        int middleNameLen = students[i].middleName.length();
-        fout.write((char *)&middleNameLen, sizeof(middleNameLen));
-        fout.write(students[i].middleName.c_str(), middleNameLen);
+// Removed lines are matched to live records by content; a removed and an
+// added line with the same full name become an in-place update. A removed
+// line with no live match was edited here too, so the local version stays.
+void applyExternalDelta(const RosterDelta &delta)
+{
+    vector<Student> removed;
+    vector<Student> added;
+    for (const string &line : delta.removed)
+    {
+        Student student;
+        if (parseTextStudent(line, student))
+            removed.push_back(student);
+    }
+    for (const string &line : delta.added)
+    {
+        Student student;
+        if (parseTextStudent(line, student))
+            added.push_back(student);
+    }
 
-        for (int j = 0; j < 3; j++)
+    unordered_multimap<uint64_t, size_t> wanted;
+    for (size_t r = 0; r < removed.size(); r++)
+        wanted.emplace(rosterRecordHash(removed[r]), r);
+    vector<int> positions(removed.size(), -1);
+    for (int i = 0; i < studentCount && !wanted.empty(); i++)
+    {
+        if (!studentLive(i))
+            continue;
+        auto range = wanted.equal_range(rosterRecordHash(students[i]));
+        for (auto it = range.first; it != range.second; ++it)
         {
-            int subjectLen = students[i].subjects[j].length();
-            fout.write((char *)&subjectLen, sizeof(subjectLen));
-            fout.write(students[i].subjects[j].c_str(), subjectLen);
+            if (sameRosterRecord(students[i], removed[it->second]))
+            {
+                positions[it->second] = i;
+                wanted.erase(it);
+                break;
+            }
+        }
+    }
 
-            int gradeLen = students[i].grades[j].length();
-            fout.write((char *)&gradeLen, sizeof(gradeLen));
-            fout.write(students[i].grades[j].c_str(), gradeLen);
+    auto fullName = [](const Student &student) {
+        return student.surname.str() + '\x1f' + student.name.str() + '\x1f' + student.middleName.str();
+    };
+    unordered_multimap<string, size_t> byName;
+    for (size_t r = 0; r < removed.size(); r++)
+        byName.emplace(fullName(removed[r]), r);
+    vector<bool> paired(removed.size(), false);
+    vector<const Student *> conflicts;
+    int updated = 0;
+    int inserted = 0;
+    int erased = 0;
+
+    applyingExternalChange = true;
+    for (Student &student : added)
+    {
+        auto found = byName.find(fullName(student));
+        if (found != byName.end())
+        {
+            size_t r = found->second;
+            byName.erase(found);
+            paired[r] = true;
+            if (positions[r] < 0)
+            {
+                conflicts.push_back(&removed[r]);
+                continue;
+            }
+            int position = positions[r];
+            Student before = students[position];
+            students[position] = move(student);
+            students[position].id = before.id;
+            onStudentUpdated(position, before);
+            updated++;
+            continue;
         }
+        if (!checkAvailability())
+            break;
+        students[studentCount] = move(student);
+        students[studentCount].id = allocateStudentId(studentCount);
+        studentCount++;
+        onStudentInserted(studentCount - 1);
+        inserted++;
     }
-    fout.close();
-    cout << "Бинарный файл сохранён.\n";
+    for (size_t r = 0; r < removed.size(); r++)
+    {
+        if (paired[r])
+            continue;
+        if (positions[r] < 0)
+        {
+            conflicts.push_back(&removed[r]);
+            continue;
+        }
+        eraseStudent(positions[r], true);
+        erased++;
+    }
+    applyingExternalChange = false;
+    if (tombstoneCount > studentCount * TOMBSTONE_COMPACT_RATIO)
+        compactStudents();
+    advanceRosterBase(delta.version);
+
+    cout << "\nФайл " << delta.version.path << " изменён другим процессом: обновлено " << updated << ", добавлено "
+         << inserted << ", удалено " << erased << ".\n";
+    for (const Student *student : conflicts)
+    {
+        cout << "Конфликт: запись " << student->surname << " " << student->name << " " << student->middleName
+             << " изменена и в файле, и здесь; оставлена ваша несохранённая версия.\n";
+    }
+}
+
+void saveToBinaryFile()
+{
+    MetricTimer timer(METRIC_SAVE_BINARY);
+    FileLock lock(FILE2_PATH, FILE_LOCK_EXCLUSIVE);
+    RosterVersion current = observeRoster(FILE2_PATH, true);
+    if (rosterBaseStale(current))
+        mergeStaleRoster(current, true);
+    uint32_t generation = nextRosterGeneration(current);
+    BinarySaveStats stats;
+    if (!saveBinaryStore(FILE2_PATH, students, studentCount, generation, stats))
+    {
+        cout << "Ошибка записи бинарного файла.\n";
+        return;
+    }
+    setRosterBase(observeRosterFile(FILE2_PATH, generation));
+    metricAddRecords(METRIC_SAVE_BINARY, stats.records);
+    metricAddBytes(METRIC_SAVE_BINARY, stats.bytes);
+    snapshotPending = true;
+    snapshotPendingBinary = true;
+    if (stats.incremental)
+        cout << "Бинарный файл обновлён на месте: записей " << stats.records << ", байт " << stats.bytes << ".\n";
+    else
+        cout << "Бинарный файл сохранён.\n";
 }
 
 void loadFromBinaryFile()
 {
-    ifstream fin(FILE2_PATH, ios::binary);
-    if (!fin)
+    MetricTimer timer(METRIC_LOAD_BINARY);
+    closeLazyStore();
+    FileLock lock(FILE2_PATH, FILE_LOCK_SHARED);
+    vector<char> buffer;
+    if (!readWholeFile(FILE2_PATH, buffer))
     {
         cout << "Бинарный файл не найден.\n";
         return;
     }
+    long long bytes = buffer.size();
+    bool slotted = isBinaryStore(buffer.data(), bytes);
     int countFromFile = 0;
-    fin.read((char *)&countFromFile, sizeof(countFromFile));
+    if (slotted)
+        countFromFile = binaryStoreLiveCount(buffer.data(), bytes);
+    else if (bytes >= (long long)sizeof(countFromFile))
+        memcpy(&countFromFile, buffer.data(), sizeof(countFromFile));
+    bool damaged = false;
+    if (countFromFile < 0)
+    {
+        cout << "Ошибка: бинарный файл повреждён.\n";
+        countFromFile = 0;
+        damaged = true;
+    }
+    long long fits = max<long long>(0, bytes - (long long)sizeof(countFromFile)) / LEGACY_BINARY_MIN_RECORD;
+    if (!slotted && countFromFile > fits)
+    {
+        cout << "Ошибка: бинарный файл повреждён: заявлено записей " << countFromFile << ", в файле помещается не больше "
+             << fits << ".\n";
+        countFromFile = fits;
+        damaged = true;
+    }
+    if (degradeIfOverBudget(FILE2_PATH, true, rosterLoadEstimate(countFromFile, bytes)))
+        return;
+
+    resetStringArenas();
+    const char *base = adoptLoadBuffer(move(buffer));
+    const char *p = base + (slotted ? 0 : min<long long>(bytes, sizeof(countFromFile)));
+    const char *last = base + bytes;
+    reserveStudents(countFromFile);
 
-    if (countFromFile > capacity)
+    studentCount = 0;
+    vector<int> slots;
+    int read = 0;
+    if (slotted)
+        read = studentCount = decodeBinaryStore(base, bytes, students, countFromFile, slots) ? countFromFile : 0;
+    else
     {
-        delete[] students;
-        students = new Student[countFromFile];
-        capacity = countFromFile;
+        string_view pairs[2 * LEGACY_BINARY_SUBJECTS];
+        while (read < countFromFile && takeBinaryStudent(p, last, students[studentCount], pairs))
+        {
+            read++;
+            if (buildLegacySubjects(pairs, LEGACY_BINARY_SUBJECTS, students[studentCount].subjects))
+                studentCount++;
+            else
+                cout << "Ошибка: запись " << read << " бинарного файла содержит неверные оценки и пропущена.\n";
+        }
+    }
+    if (read < countFromFile)
+    {
+        cout << "Ошибка: бинарный файл повреждён, загружено записей: " << studentCount << ".\n";
+        damaged = true;
     }
 
-    for (int i = 0; i < countFromFile; i++)
+    metricAddRecords(METRIC_LOAD_BINARY, studentCount);
+    metricAddBytes(METRIC_LOAD_BINARY, bytes);
+    assignStudentIds();
+    if (slotted && studentCount == countFromFile && binaryStoreVersion(base, bytes) == BINARY_STORE_VERSION)
+        bindBinaryStore(FILE2_PATH, students, slots, base, bytes);
+    else
+        unbindBinaryStore();
+    onRosterReloaded();
+    sortStudentsByYear();
+    resetRosterBases();
+    uint32_t generation = 0;
+    if (slotted)
+        memcpy(&generation, base + offsetof(BinaryStoreHeader, generation), sizeof(generation));
+    RosterVersion loaded = observeRosterFile(FILE2_PATH, generation);
+    setRosterBase(loaded);
+    watchLoadedRoster(loaded, true);
+    if (damaged)
     {
-        fin.read((char *)&students[i].year, sizeof(students[i].year));
-        fin.read((char *)&students[i].course, sizeof(students[i].course));
+        cout << "Бинарный файл загружен не полностью: сохранение перезапишет его только прочитанными записями.\n";
+        reportLoadedDuplicates();
+        return;
+    }
+    refreshSnapshot(FILE2_PATH, true);
+    cout << "Бинарный файл загружен.\n";
+    reportLoadedDuplicates();
+}
 
-        int nameLen = 0;
-        fin.read((char *)&nameLen, sizeof(nameLen));
-        students[i].name.resize(nameLen);
-        fin.read(&students[i].name[0], nameLen);
+bool loadFromSnapshot()
+{
+    MetricTimer timer(METRIC_LOAD_SNAPSHOT);
+    SnapshotSource source;
+    int count = 0;
+    resetStringArenas();
+    SnapshotSource recorded;
+    if (!readSnapshotSource(SNAPSHOT_PATH, recorded))
+        return false;
+    FileLock lock(recorded.path, FILE_LOCK_SHARED);
+    if (!mapSnapshot(SNAPSHOT_PATH, source, count))
+        return false;
+    if (!memoryBudgetAllows((size_t)(count + 1) * sizeof(Student)))
+    {
+        resetStringArenas();
+        cout << "Снимок " << SNAPSHOT_PATH << " не помещается в бюджет памяти.\n";
+        return false;
+    }
 
-        int surnameLen = 0;
-        fin.read((char *)&surnameLen, sizeof(surnameLen));
-        students[i].surname.resize(surnameLen);
-        fin.read(&students[i].surname[0], surnameLen);
+    reserveStudents(count + 1);
+    vector<int> slots;
+    if (!readSnapshotRecords(students, count, slots))
+    {
+        studentCount = 0;
+        resetStringArenas();
+        cout << "Снимок " << SNAPSHOT_PATH << " повреждён.\n";
+        return false;
+    }
+    studentCount = count;
+
+    metricAddRecords(METRIC_LOAD_SNAPSHOT, studentCount);
+    metricAddBytes(METRIC_LOAD_SNAPSHOT, mappedArenaBytes());
+    assignStudentIds();
+    if (source.binary && source.path == FILE2_PATH && find(slots.begin(), slots.end(), -1) == slots.end())
+        bindBinaryStore(FILE2_PATH, students, slots, nullptr, 0);
+    else
+        unbindBinaryStore();
+    onRosterReloaded();
+    resetRosterBases();
+    RosterVersion loaded = observeRoster(source.path, source.binary);
+    setRosterBase(loaded);
+    watchLoadedRoster(loaded, source.binary);
+    cout << "Открыт снимок " << source.path << ": " << studentCount << " записей.\n";
+    return true;
+}
 
-        int middleNameLen = 0;
-        fin.read((char *)&middleNameLen, sizeof(middleNameLen));
-        students[i].middleName.resize(middleNameLen);
-        fin.read(&students[i].middleName[0], middleNameLen);
+void refreshSnapshot(const string &sourcePath, bool binary)
+{
+    vector<int> slots;
+    if (binary && binaryStoreBoundTo(sourcePath))
+    {
+        slots.resize(studentCount);
+        for (int i = 0; i < studentCount; i++)
+            slots[i] = studentLive(i) ? binaryStoreSlotOf(students[i].id) : -1;
+    }
+    snapshotPending = false;
+    if (!writeSnapshot(SNAPSHOT_PATH, {sourcePath, binary}, students, studentCount, slots))
+        cout << "Предупреждение: не удалось обновить снимок " << SNAPSHOT_PATH << ".\n";
+}
 
-        for (int j = 0; j < 3; j++)
-        {
-            int subjectLen = 0;
-            fin.read((char *)&subjectLen, sizeof(subjectLen));
-            students[i].subjects[j].resize(subjectLen);
-            fin.read(&students[i].subjects[j][0], subjectLen);
+// Saves only mark the snapshot pending: rewriting it on every save would
+// double the cost of a one-field edit. Loads write it at once, exit flushes
+// it, and a snapshot left stale by a crash fails its freshness check.
+void flushPendingSnapshot()
+{
+    if (snapshotPending && !lazyStoreActive())
+        refreshSnapshot(snapshotPendingBinary ? FILE2_PATH : FILE1_PATH, snapshotPendingBinary);
+}
 
-            int gradeLen = 0;
-            fin.read((char *)&gradeLen, sizeof(gradeLen));
-            students[i].grades[j].resize(gradeLen);
-            fin.read(&students[i].grades[j][0], gradeLen);
-        }
+// Startup serves records straight from the mapped snapshot, so opening does
+// not walk the roster; the first choice that needs all of it, an edit
+// included, loads it through materializeLazyStore().
+bool openSnapshotView()
+{
+    SnapshotSource recorded;
+    if (!readSnapshotSource(SNAPSHOT_PATH, recorded))
+        return false;
+    FileLock lock(recorded.path, FILE_LOCK_SHARED);
+    closeLazyStore();
+    resetStringArenas();
+    SnapshotSource source;
+    int count = 0;
+    if (!mapSnapshot(SNAPSHOT_PATH, source, count))
+    {
+        resetStringArenas();
+        return false;
     }
+    releaseRosterForLazyStore();
+    openLazySnapshot(source, count);
+    cout << "Открыт снимок " << source.path << ": " << count << " записей.\n";
+    return true;
+}
 
-    studentCount = countFromFile;
-    fin.close();
-    sortStudentsByYear();
-    cout << "Бинарный файл загружен.\n";
+void autoOpenDataset()
+{
+    if (!openSnapshotView())
+        loadDatasetSource();
+}
+
+void loadDatasetSource()
+{
+    SnapshotSource source = {FILE1_PATH, false};
+    if (!readSnapshotSource(SNAPSHOT_PATH, source) && !filesystem::exists(FILE1_PATH))
+        source = {FILE2_PATH, true};
+    if (!filesystem::exists(source.path))
+        return;
+    if (source.binary)
+        loadFromBinaryFile();
+    else
+        loadFromFile();
 }